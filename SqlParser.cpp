@@ -1,15 +1,107 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <filesystem>
 #include <fstream>
 #include <functional>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <ranges>
 #include <spdlog/spdlog.h>
+#include <sstream>
+#include <unordered_set>
 
 #include "Record/Record.hpp"
 #include "SqlParser.hpp"
+#include "arrow_ipc.hpp"
+#include "bulk_format.hpp"
+#include "csv_export.hpp"
+#include "metrics.hpp"
+#include "morsel.hpp"
+#include "operators.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+namespace {
+
+// Runs one DBEngine call inside a trace span
+template <typename Call>
+auto traced(const char *name, std::string_view tablename, Call &&call) {
+  trace_span span(name, "engine", tablename);
+  return call();
+}
+
+auto to_column_type(const Type &type) -> column_type_t {
+  switch (type.type) {
+  case Type::INT:
+    return column_type_t::INT32;
+  case Type::FLOAT:
+    return column_type_t::FLOAT64;
+  case Type::BOOL:
+    return column_type_t::BOOL;
+  case Type::VARCHAR:
+    break;
+  }
+  return column_type_t::UTF8;
+}
+
+// Every engine instance writes meta.data and index files from its own view
+// of the catalog. Schema changes hold this, so the engine building an index
+// in the background never writes them while the session's engine does.
+auto catalog_mutex() -> std::mutex & {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Bumped by every schema change in the process
+auto catalog_generation() -> std::atomic<uint64_t> & {
+  static std::atomic<uint64_t> generation{0};
+  return generation;
+}
+
+// The engine's catalog file, rewritten by schema changes of any process
+constexpr const char *CATALOG_FILE = "meta.data";
+
+auto catalog_written() -> std::filesystem::file_time_type {
+  std::error_code error;
+  const auto written = std::filesystem::last_write_time(CATALOG_FILE, error);
+  return error ? std::filesystem::file_time_type{} : written;
+}
+
+// Below this many rows a filter runs inside the engine's scan. Above it,
+// with several workers, filtering in morsels can outweigh loading the
+// columns it reads first.
+constexpr std::size_t PARALLEL_FILTER_ROWS = 16 * MORSEL_ROWS;
+
+// A filter matching more than 1 in this many rows fetches its projected
+// columns with one scan rather than a search per key
+constexpr std::size_t LATE_FETCH_RATIO = 16;
+
+// Which columns a filter compares and how, without the values, so queries
+// differing only in their literals share a selectivity estimate
+auto filter_shape(const std::string &tablename,
+                  const std::list<condition_t> &conditions) -> std::string {
+  std::string shape = tablename;
+  for (const auto &condition : conditions) {
+    shape += '\0';
+    shape += condition.column_name;
+    shape += static_cast<char>('0' + condition.c);
+  }
+  return shape;
+}
+
+} // namespace
 
 SqlParser::~SqlParser() {
+  try {
+    settle_index_builds(true);
+    flush_inserts();
+  } catch (const std::exception &e) {
+    spdlog::error("Lost {} buffered rows: {}", m_pending_rows, e.what());
+  }
   delete m_sc;
   delete m_parser;
 }
@@ -31,7 +123,326 @@ auto SqlParser::parse(std::istream &stream) -> ParserResponse & {
   return this->m_parser_response;
 }
 
-void SqlParser::parse_helper(std::istream &stream) {
+auto SqlParser::parse_query(std::string_view query) -> ParserResponse & {
+  start_statement();
+  try {
+    if (try_point_query(query)) {
+      record_statement(m_point_query.fingerprint, query);
+      return this->m_parser_response;
+    }
+  } catch (const std::exception &) {
+    capture_failed(query);
+    throw;
+  }
+  m_statement.clear();
+  std::istringstream stream{std::string(query)};
+  parse_helper(stream, query);
+  return this->m_parser_response;
+}
+
+auto SqlParser::try_point_query(std::string_view query) -> bool {
+  auto phases = start_phase(phase_t::PARSE);
+  if (!match_point_query(query, m_point_query)) {
+    return false;
+  }
+  phases.enter(phase_t::PLAN);
+
+  // Anything the general path would reject is left for it to report
+  const std::string tablename(m_point_query.table);
+  set_statement("select", tablename);
+  if (!traced("is_table", tablename,
+              [&] { return m_engine.is_table(tablename); })) {
+    return false;
+  }
+  const auto &info = table_info(tablename);
+
+  const std::string key_column(m_point_query.key_column);
+  if (std::ranges::find(info.indexes, key_column) == info.indexes.end()) {
+    return false;
+  }
+
+  auto sorted_column_names = traced("sort_attributes", tablename, [&] {
+    return m_engine.sort_attributes(
+        tablename,
+        m_point_query.columns.empty()
+            ? info.attributes
+            : std::vector<std::string>(m_point_query.columns.begin(),
+                                       m_point_query.columns.end()));
+  });
+  if (std::ranges::any_of(sorted_column_names, [&](const auto &col) {
+        return std::ranges::find(info.attributes, col) ==
+               info.attributes.end();
+      })) {
+    return false;
+  }
+
+  phases.enter(phase_t::EXECUTE);
+  QueryResponse query_response = traced("search", tablename, [&] {
+    return m_engine.search(
+        tablename, {key_column, m_point_query.key_value},
+        [](const Record & /*rec*/) { return true; }, sorted_column_names);
+  });
+  add_plan_step(tablename, "search", key_column,
+                query_response.records.size());
+
+  // select() deduplicates every OR branch, keep the same result
+  if (query_response.records.size() > 1) {
+    std::vector<Record> unique;
+    union_op merged(unique, m_merge_slots);
+    push_rows(query_response.records, merged);
+    query_response.records.swap(unique);
+  }
+  phases.enter(phase_t::OUTPUT);
+  query_to_output(tablename, std::move(query_response), sorted_column_names);
+  return true;
+}
+
+void SqlParser::enable_perf_counters(bool enabled) {
+  m_perf_counters = enabled ? std::make_unique<perf_counters>() : nullptr;
+}
+
+void SqlParser::explain_next() { m_explain = true; }
+
+void SqlParser::export_next(const std::string &filename) {
+  m_export_path = filename.substr(1, filename.length() - 2);
+}
+
+auto SqlParser::start_phase(phase_t phase) -> phase_timer {
+  return {m_statement, phase, m_perf_counters.get()};
+}
+
+void SqlParser::start_statement() {
+  if (index_builds().count != 0) {
+    settle_index_builds(false);
+  }
+  refresh_catalog();
+
+  // A statement that failed may have left these behind
+  m_explain = false;
+  m_export_path.clear();
+
+  m_statement_start = std::chrono::steady_clock::now();
+  if (m_perf_counters) {
+    m_statement_counters = m_perf_counters->read();
+  }
+  if constexpr (ALLOC_PROFILING) {
+    alloc_mark_statement();
+    m_statement_allocs = alloc_counters();
+  }
+}
+
+void SqlParser::refresh_catalog() {
+  const auto generation = catalog_generation().load(std::memory_order_acquire);
+  const auto written = catalog_written();
+  if (generation == m_catalog_generation && written == m_catalog_written) {
+    return;
+  }
+  m_catalog_generation = generation;
+  m_catalog_written = written;
+  m_catalog.clear();
+  m_table_names_valid = false;
+  m_table_rows.clear();
+}
+
+// The session's own change was already applied to its cache, it only drops
+// the cache again if another change came in between
+void SqlParser::schema_changed() {
+  const auto before =
+      catalog_generation().fetch_add(1, std::memory_order_acq_rel);
+  if (before == m_catalog_generation) {
+    m_catalog_generation = before + 1;
+    m_catalog_written = catalog_written();
+  }
+}
+
+void SqlParser::end_statement() {
+  record_statement(m_sc->fingerprint(), m_sc->statement_text());
+  // A file or stream runs many statements in one parse, builds that
+  // finished are applied between each of them
+  if (index_builds().count != 0) {
+    settle_index_builds(false);
+  }
+}
+
+auto SqlParser::get_fingerprint_stats(uint64_t fingerprint) const
+    -> const fingerprint_stats_t * {
+  const auto it = m_fingerprint_entries.find(fingerprint);
+  return it == m_fingerprint_entries.end() ? nullptr : &it->second->stats;
+}
+
+auto SqlParser::fingerprint_stats(uint64_t fingerprint)
+    -> fingerprint_stats_t & {
+  const auto it = m_fingerprint_entries.find(fingerprint);
+  if (it != m_fingerprint_entries.end()) {
+    m_fingerprint_stats.splice(m_fingerprint_stats.begin(),
+                               m_fingerprint_stats, it->second);
+    return it->second->stats;
+  }
+  if (m_fingerprint_stats.size() >= MAX_FINGERPRINTS) {
+    m_fingerprint_entries.erase(m_fingerprint_stats.back().fingerprint);
+    m_fingerprint_stats.pop_back();
+  }
+  auto &entry = m_fingerprint_stats.emplace_front();
+  entry.fingerprint = fingerprint;
+  m_fingerprint_entries.emplace(fingerprint, m_fingerprint_stats.begin());
+  return entry.stats;
+}
+
+void SqlParser::record_statement(uint64_t fingerprint, std::string_view text) {
+  const auto now = std::chrono::steady_clock::now();
+  m_statement.total = now - m_statement_start;
+
+  // Time not claimed by a phase_timer went to lexing and the grammar
+  auto &parse_time =
+      m_statement.phase_times[static_cast<std::size_t>(phase_t::PARSE)];
+  auto unattributed = m_statement.total;
+  for (const auto &phase_time : m_statement.phase_times) {
+    unattributed -= phase_time;
+  }
+  parse_time += std::max(unattributed, std::chrono::nanoseconds{0});
+
+  if (m_perf_counters) {
+    const auto counters = m_perf_counters->read();
+    auto &parse_counters =
+        m_statement.phase_counters[static_cast<std::size_t>(phase_t::PARSE)];
+    for (std::size_t i = 0; i < COUNTERS; ++i) {
+      uint64_t unattributed_count = counters[i] - m_statement_counters[i];
+      for (const auto &phase_counters : m_statement.phase_counters) {
+        unattributed_count -= std::min(unattributed_count, phase_counters[i]);
+      }
+      parse_counters[i] += unattributed_count;
+    }
+    m_statement.has_counters = true;
+    m_statement_counters = counters;
+  }
+
+  if constexpr (ALLOC_PROFILING) {
+    const alloc_counters_t allocs = alloc_counters();
+    auto &total = m_statement.allocs;
+    total.allocations = allocs.allocations - m_statement_allocs.allocations;
+    total.bytes = allocs.bytes - m_statement_allocs.bytes;
+    total.peak_bytes = static_cast<uint64_t>(
+        std::max<int64_t>(allocs.statement_peak - m_statement_allocs.live, 0));
+
+    auto &parse_allocs =
+        m_statement.phase_allocs[static_cast<std::size_t>(phase_t::PARSE)];
+    alloc_stats_t unattributed_allocs = total;
+    for (const auto &phase_allocs : m_statement.phase_allocs) {
+      unattributed_allocs.allocations -= std::min(
+          unattributed_allocs.allocations, phase_allocs.allocations);
+      unattributed_allocs.bytes -=
+          std::min(unattributed_allocs.bytes, phase_allocs.bytes);
+    }
+    parse_allocs.allocations += unattributed_allocs.allocations;
+    parse_allocs.bytes += unattributed_allocs.bytes;
+
+    alloc_mark_statement();
+    m_statement_allocs = allocs;
+  }
+
+  metrics_registry::instance().record_statement(m_statement);
+
+  auto &stats = fingerprint_stats(fingerprint);
+  stats.latency_ns.record(static_cast<uint64_t>(m_statement.total.count()));
+  stats.rows.record(m_statement.rows_returned);
+
+  if (m_capture) {
+    m_capture->record(std::chrono::system_clock::now() -
+                          std::chrono::duration_cast<
+                              std::chrono::system_clock::duration>(
+                              m_statement.total),
+                      m_session_id, text);
+  }
+  if (m_slow_log && m_statement.total >= m_slow_log->threshold()) {
+    m_slow_log->push({std::chrono::system_clock::now(), std::string(text),
+                      fingerprint, m_statement});
+  }
+
+  if (m_explain) {
+    m_parser_response.records.clear();
+    m_parser_response.text = explain_analyze(m_statement);
+    m_explain = false;
+  }
+
+  m_parser_response.fingerprint = fingerprint;
+  m_parser_response.stats = std::move(m_statement);
+  m_statement.clear();
+  m_statement_start = now;
+}
+
+// Replaying a capture should hit the same errors, so failures are kept too
+void SqlParser::capture_failed(std::string_view text) {
+  if (!m_capture || text.empty()) {
+    return;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - m_statement_start;
+  m_capture->record(
+      std::chrono::system_clock::now() -
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              elapsed),
+      m_session_id, text);
+}
+
+void SqlParser::set_statement(std::string_view type,
+                              const std::string &tablename) {
+  m_statement.type = type;
+  m_statement.table = tablename;
+  if (m_pending_rows != 0 && type != "insert") {
+    flush_inserts();
+  }
+  // Writes logged during a build aren't in the table yet, a read waits for
+  // the build rather than miss them
+  if (index_builds().count != 0 && (type == "select" || type == "copy")) {
+    if (const auto build = find_index_build(tablename)) {
+      std::unique_lock lock(build->mutex);
+      const bool logged = !build->side_log.empty();
+      lock.unlock();
+      if (logged) {
+        wait_index_build(tablename);
+      }
+    }
+  }
+}
+
+void SqlParser::show_metrics() {
+  trace_span span("show_metrics", "grammar");
+  set_statement("show", {});
+  m_parser_response.records.clear();
+  m_parser_response.text = metrics_registry::instance().prometheus();
+}
+
+void SqlParser::add_plan_step(const std::string &tablename,
+                              std::string access, std::string index_column,
+                              std::size_t rows, std::size_t probes) {
+  if (index_column.empty()) {
+    probes = 0;
+  }
+  m_statement.plan.push_back({tablename, std::move(access),
+                              std::move(index_column), rows, probes});
+  m_statement.rows_examined += rows;
+}
+
+auto SqlParser::table_info(const std::string &tablename)
+    -> const table_info_t & {
+  auto it = m_catalog.find(tablename);
+  if (it == m_catalog.end()) {
+    table_info_t info;
+    info.attributes = traced("get_table_attributes", tablename, [&] {
+      return m_engine.get_table_attributes(tablename);
+    });
+    info.indexes = traced("get_indexes_names", tablename, [&] {
+      return m_engine.get_indexes_names(tablename);
+    });
+    // The engine may list an index still being built, it isn't complete
+    if (const auto build = find_index_build(tablename)) {
+      std::erase(info.indexes, build->column);
+    }
+    it = m_catalog.emplace(tablename, std::move(info)).first;
+  }
+  return it->second;
+}
+
+void SqlParser::parse_helper(std::istream &stream, std::string_view query) {
   delete (m_sc);
   try {
     m_sc = new scanner(&stream);
@@ -46,17 +457,36 @@ void SqlParser::parse_helper(std::istream &stream) {
     spdlog::error("Failed to allocate parser: ({})", ba.what());
     throw ba;
   }
+  m_sc->capture_text(m_slow_log != nullptr || m_capture != nullptr);
 
+  start_statement();
   const int ACCEPT(0);
-  if (m_parser->parse() != ACCEPT) {
-    spdlog::error("Parsing failed");
-    throw std::runtime_error("Parsing failed");
+  try {
+    if (m_parser->parse() != ACCEPT) {
+      spdlog::error("Parsing failed");
+      throw std::runtime_error("Parsing failed");
+    }
+  } catch (const std::exception &) {
+    if (!query.empty()) {
+      capture_failed(query);
+      throw;
+    }
+    // Errors are mostly raised before the ';' is lexed, end the statement so
+    // it fails the same way when replayed
+    std::string text = m_sc->failed_statement_text();
+    if (!text.empty() && !text.ends_with(';')) {
+      text += " ;";
+    }
+    capture_failed(text);
+    throw;
   }
 }
 
 void SqlParser::check_table_name(const std::string &tablename) {
+  trace_span span("check_table_name", "grammar", tablename);
   spdlog::info("Cheking Table : {}", tablename);
-  if (!this->m_engine.is_table(tablename)) {
+  if (!traced("is_table", tablename,
+              [&] { return m_engine.is_table(tablename); })) {
     spdlog::error("Table doesn't exists");
     throw std::runtime_error("Table doesn't exists");
   }
@@ -64,6 +494,9 @@ void SqlParser::check_table_name(const std::string &tablename) {
 
 void SqlParser::create_table(const std::string &tablename,
                              const std::vector<column_t> &columns) {
+  trace_span span("create_table", "grammar", tablename);
+  auto phases = start_phase(phase_t::EXECUTE);
+  set_statement("create_table", tablename);
 
   std::vector<Type> col_types;
   std::vector<std::string> col_names;
@@ -82,35 +515,224 @@ void SqlParser::create_table(const std::string &tablename,
     col_names.push_back(col.name);
   }
 
-  m_engine.create_table(tablename, primary_key, col_types, col_names);
+  auto &types = m_column_types[tablename];
+  types.clear();
+  for (const auto &col : columns) {
+    types[col.name] = to_column_type(col.type);
+  }
+
+  m_catalog.erase(tablename);
+  m_table_names_valid = false;
+  std::lock_guard lock(catalog_mutex());
+  traced("create_table", tablename, [&] {
+    m_engine.create_table(tablename, primary_key, col_types, col_names);
+  });
+  schema_changed();
 }
 
 void SqlParser::create_index(const std::string &tablename,
                              const std::string &column_name,
                              const DB_ENGINE::DBEngine::Index_t &index_name) {
+  trace_span span("create_index", "grammar", tablename);
+  auto phases = start_phase(phase_t::EXECUTE);
+  set_statement("create_index", tablename);
+  wait_index_build(tablename);
+  check_index_column(tablename, column_name);
+
+  m_catalog.erase(tablename);
+  std::lock_guard lock(catalog_mutex());
+  traced("create_index", tablename, [&] {
+    m_engine.create_index(tablename, column_name, index_name);
+  });
+  schema_changed();
+}
+
+void SqlParser::create_index_concurrently(
+    const std::string &tablename, const std::string &column_name,
+    const DB_ENGINE::DBEngine::Index_t &index_name) {
+  trace_span span("create_index_concurrently", "grammar", tablename);
+  auto phases = start_phase(phase_t::EXECUTE);
+  set_statement("create_index", tablename);
+  wait_index_build(tablename);
+  check_index_column(tablename, column_name);
+
+  auto build = std::make_shared<index_build_t>();
+  build->column = column_name;
+  build->done = task_scheduler::async([tablename, column_name, index_name] {
+    trace_span span("create_index", "engine", tablename);
+    std::lock_guard lock(catalog_mutex());
+    DB_ENGINE::DBEngine engine;
+    engine.create_index(tablename, column_name, index_name);
+  });
+  auto &registry = index_builds();
+  std::lock_guard lock(registry.mutex);
+  registry.builds.emplace(tablename, std::move(build));
+  ++registry.count;
+}
+
+auto SqlParser::index_builds() -> build_registry_t & {
+  static build_registry_t registry;
+  return registry;
+}
+
+auto SqlParser::find_index_build(const std::string &tablename)
+    -> std::shared_ptr<index_build_t> {
+  auto &registry = index_builds();
+  std::lock_guard lock(registry.mutex);
+  const auto it = registry.builds.find(tablename);
+  return it == registry.builds.end() ? nullptr : it->second;
+}
+
+auto SqlParser::log_side_write(const std::string &tablename,
+                               side_write_t &&write) -> bool {
+  if (index_builds().count == 0) {
+    return false;
+  }
+  const auto build = find_index_build(tablename);
+  if (!build) {
+    return false;
+  }
+  std::lock_guard lock(build->mutex);
+  if (build->applied) {
+    return false;
+  }
+  build->side_log.push_back(std::move(write));
+  return true;
+}
 
+void SqlParser::check_index_column(const std::string &tablename,
+                                   const std::string &column_name) {
   // Validate table
-  if (!m_engine.is_table(tablename)) {
+  if (!traced("is_table", tablename,
+              [&] { return m_engine.is_table(tablename); })) {
     spdlog::error("Table doesn't exists");
     throw std::runtime_error("Table doesn't exists");
   }
 
   // Validate attribute
-  auto attributes = m_engine.get_table_attributes(tablename);
+  const auto &attributes = table_info(tablename).attributes;
   if (std::ranges::find(attributes, column_name) == attributes.end()) {
     spdlog::error("Column doesn't exists");
     throw std::runtime_error("Column doesn't exists");
   }
+}
+
+void SqlParser::settle_index_builds(bool wait) {
+  std::vector<std::pair<std::string, std::shared_ptr<index_build_t>>> ready;
+  {
+    auto &registry = index_builds();
+    std::lock_guard lock(registry.mutex);
+    for (const auto &[tablename, build] : registry.builds) {
+      if (wait || build->done.wait_for(std::chrono::seconds{0}) ==
+                      std::future_status::ready) {
+        ready.emplace_back(tablename, build);
+      }
+    }
+  }
+  for (const auto &[tablename, build] : ready) {
+    apply_index_build(tablename, *build);
+  }
+}
+
+void SqlParser::wait_index_build(const std::string &tablename) {
+  if (const auto build = find_index_build(tablename)) {
+    apply_index_build(tablename, *build);
+  }
+}
+
+void SqlParser::apply_index_build(const std::string &tablename,
+                                  index_build_t &build) {
+  trace_span span("apply_index_build", "grammar", tablename);
+  build.done.wait();
+  {
+    auto &registry = index_builds();
+    std::lock_guard lock(registry.mutex);
+    const auto it = registry.builds.find(tablename);
+    if (it != registry.builds.end() && it->second.get() == &build) {
+      registry.builds.erase(it);
+      --registry.count;
+    }
+  }
+  // Held while the log is applied, a write that finds the build applied
+  // goes to the table after every logged one
+  std::lock_guard lock(build.mutex);
+  if (build.applied) {
+    return;
+  }
+  build.applied = true;
+  try {
+    build.done.get();
+  } catch (const std::exception &e) {
+    // The side log is still applied, only the index is missing
+    spdlog::error("Building index on {}.{} failed: {}", tablename,
+                  build.column, e.what());
+  }
 
-  m_engine.create_index(tablename, column_name, index_name);
+  // From here on the planner may use the index, and the logged writes
+  // maintain it like any other
+  m_catalog.erase(tablename);
+  schema_changed();
+  for (const auto &write : build.side_log) {
+    if (write.values.empty()) {
+      traced("remove", tablename,
+             [&] { m_engine.remove(tablename, write.key); });
+    } else {
+      traced("add", tablename, [&] {
+        m_engine.add(tablename, {write.values.begin(), write.values.end()});
+      });
+    }
+  }
 }
 
 void SqlParser::select(const std::string &tablename,
                        const std::vector<std::string> &column_names,
                        const std::list<std::list<condition_t>> &constraints) {
-  auto sorted_column_names = m_engine.sort_attributes(tablename, column_names);
+  trace_span span("select", "grammar", tablename);
+  auto phases = start_phase(phase_t::PLAN);
+  set_statement("select", tablename);
+  auto sorted_column_names = traced("sort_attributes", tablename, [&] {
+    return m_engine.sort_attributes(tablename, column_names);
+  });
+
+  auto query_response =
+      run_select(tablename, sorted_column_names, constraints, phases);
+  phases.enter(phase_t::OUTPUT);
+  query_to_output(tablename, std::move(query_response), sorted_column_names);
+}
+
+void SqlParser::copy_to(const std::string &tablename,
+                        const std::string &filename,
+                        const std::list<std::list<condition_t>> &constraints) {
+  trace_span span("copy_to", "grammar", tablename);
+  auto phases = start_phase(phase_t::PLAN);
+  set_statement("copy", tablename);
+  auto sorted_column_names = traced("sort_attributes", tablename, [&] {
+    return m_engine.sort_attributes(tablename,
+                                    table_info(tablename).attributes);
+  });
+  auto query_response =
+      run_select(tablename, sorted_column_names, constraints, phases);
 
-  const auto &table_attributes = this->m_engine.get_table_attributes(tablename);
+  phases.enter(phase_t::OUTPUT);
+  const auto file_name = filename.substr(1, filename.length() - 2);
+  const auto stats = [&] {
+    trace_span write_span("write_csv", "output", file_name);
+    return write_csv(file_name, query_response.records, sorted_column_names);
+  }();
+  m_statement.bytes_written += stats.bytes;
+  m_parser_response.text = fmt::format(
+      "{} rows, {} bytes written to {} in {:.1f} ms ({:.1f} MB/s)\n",
+      stats.rows, stats.bytes, file_name,
+      std::chrono::duration<double, std::milli>(stats.elapsed).count(),
+      stats.mb_per_second());
+}
+
+auto SqlParser::run_select(
+    const std::string &tablename,
+    const std::vector<std::string> &sorted_column_names,
+    const std::list<std::list<condition_t>> &constraints, phase_timer &phases)
+    -> QueryResponse {
+  const auto &table_attributes = table_info(tablename).attributes;
 
   QueryResponse query_response;
 
@@ -125,17 +747,26 @@ void SqlParser::select(const std::string &tablename,
 
   // No indexed attribute found
   if (constraints.empty()) {
-    query_response = m_engine.load(tablename, sorted_column_names);
+    phases.enter(phase_t::EXECUTE);
+    query_response = traced("load", tablename, [&] {
+      return m_engine.load(tablename, sorted_column_names);
+    });
+    add_plan_step(tablename, "load", {}, query_response.records.size());
+    m_table_rows[tablename] = query_response.records.size();
     spdlog::info("Query response size: {}", query_response.records.size());
-    query_to_output(query_response, sorted_column_names);
-    return;
+    return query_response;
   }
 
+  // Index branches are unioned into the response as they come back
+  union_op merged(query_response.records, m_merge_slots);
+
   // Iterating OR constraints
   for (const auto &or_constraint : constraints) {
+    phases.enter(phase_t::PLAN);
 
     condition_t constraint_key;
     std::vector<std::function<bool(const DB_ENGINE::Record &rec)>> lambdas;
+    std::vector<const condition_t *> lambda_conditions; // What each compares
 
     // Iterating the AND contraints
     for (const auto &column_constraint : or_constraint) {
@@ -145,17 +776,20 @@ void SqlParser::select(const std::string &tablename,
 
       spdlog::info("Column constraint: {}", column_constraint.column_name);
 
-      auto indexes = this->m_engine.get_indexes_names(tablename);
+      const auto &indexes = table_info(tablename).indexes;
 
       // If the column doesnt has an index
       if (std::ranges::find(indexes, column_constraint.column_name) ==
           indexes.end()) {
 
-        auto record_comp = m_engine.get_comparator(
-            tablename, column_constraint.c, column_constraint.column_name,
-            column_constraint.value);
+        auto record_comp = traced("get_comparator", tablename, [&] {
+          return m_engine.get_comparator(tablename, column_constraint.c,
+                                         column_constraint.column_name,
+                                         column_constraint.value);
+        });
 
         lambdas.push_back(record_comp);
+        lambda_conditions.push_back(&column_constraint);
 
         // If the column has an index and the constraint_key is empty
       } else if (constraint_key.column_name.empty()) {
@@ -165,26 +799,118 @@ void SqlParser::select(const std::string &tablename,
 
     // Convert vec of lambdas to a single one
     spdlog::info("Lambdas size: {}", lambdas.size());
+    const bool has_filter = !lambdas.empty();
     auto joined_lambdas = [lambdas](const Record &rec) {
       return std::ranges::all_of(lambdas, [&](const auto &single_lambda) {
         return single_lambda(rec);
       });
     };
 
+    // No indexed key in constraints, a selective filter is answered from
+    // the columns it reads before the projected ones are fetched
+    if (constraint_key.column_name.empty() && has_filter) {
+      phases.enter(phase_t::EXECUTE);
+      if (late_select(tablename, sorted_column_names, or_constraint,
+                      joined_lambdas, query_response)) {
+        break;
+      }
+    }
+
+    // No indexed key in constraints. On a table known to be large, with
+    // workers to spare, the filter and projection run in morsels instead of
+    // inside the engine's serial scan. The pool is only started once a table
+    // is that large.
+    const auto rows_seen = m_table_rows.find(tablename);
+    if (constraint_key.column_name.empty() && has_filter &&
+        rows_seen != m_table_rows.end() &&
+        rows_seen->second >= PARALLEL_FILTER_ROWS &&
+        task_scheduler::instance().workers() > 1) {
+      phases.enter(phase_t::EXECUTE);
+      // Only the columns the filter and projection read are loaded
+      std::vector<std::string> narrow = sorted_column_names;
+      for (const auto &condition : or_constraint) {
+        if (std::ranges::find(narrow, condition.column_name) == narrow.end()) {
+          narrow.push_back(condition.column_name);
+        }
+      }
+      narrow = traced("sort_attributes", tablename, [&] {
+        return m_engine.sort_attributes(tablename, narrow);
+      });
+      auto rows = traced("load", tablename,
+                         [&] { return m_engine.load(tablename, narrow); });
+      add_plan_step(tablename, "load", {}, rows.records.size());
+      m_table_rows[tablename] = rows.records.size();
+
+      std::vector<std::size_t> columns;
+      columns.reserve(sorted_column_names.size());
+      for (const auto &column : sorted_column_names) {
+        columns.push_back(static_cast<std::size_t>(
+            std::ranges::find(narrow, column) - narrow.begin()));
+      }
+      std::vector<std::size_t> table_positions;
+      for (const auto &column : narrow) {
+        table_positions.push_back(static_cast<std::size_t>(
+            std::ranges::find(table_attributes, column) -
+            table_attributes.begin()));
+      }
+      auto widen = [&](std::function<bool(const Record &)> predicate) {
+        return narrow.size() < table_attributes.size()
+                   ? widen_predicate(std::move(predicate), table_positions,
+                                     table_attributes.size())
+                   : predicate;
+      };
+
+      // Comparisons with a string literal run once per distinct value of a
+      // morsel and rows are matched by code, the rest run on every row
+      std::vector<value_predicate_t> by_value;
+      std::vector<std::function<bool(const Record &)>> per_row;
+      for (std::size_t i = 0; i < lambdas.size(); ++i) {
+        const auto &condition = *lambda_conditions[i];
+        if (condition.value.starts_with('\'')) {
+          by_value.push_back(
+              {static_cast<std::size_t>(
+                   std::ranges::find(narrow, condition.column_name) -
+                   narrow.begin()),
+               widen(lambdas[i])});
+        } else {
+          per_row.push_back(lambdas[i]);
+        }
+      }
+      std::function<bool(const Record &)> filter;
+      if (!per_row.empty()) {
+        filter = widen([per_row = std::move(per_row)](const Record &rec) {
+          return std::ranges::all_of(
+              per_row, [&](const auto &predicate) { return predicate(rec); });
+        });
+      }
+      query_response.query_times = std::move(rows.query_times);
+      query_response.records = filter_project(std::move(rows.records), filter,
+                                              columns, by_value);
+      break;
+    }
+
     // No indexed key in constraints, performing linear search
     if (constraint_key.column_name.empty()) {
+      phases.enter(phase_t::EXECUTE);
       spdlog::error("INIT LOAD");
-      query_response =
-          m_engine.load(tablename, sorted_column_names, joined_lambdas);
+      query_response = traced("load", tablename, [&] {
+        return m_engine.load(tablename, sorted_column_names, joined_lambdas);
+      });
+      add_plan_step(tablename, "load", {}, query_response.records.size());
       spdlog::error("INIT LOADED {}", query_response.records.size());
       break;
     }
 
+    phases.enter(phase_t::EXECUTE);
     QueryResponse or_response;
     if (constraint_key.c == Comp::EQUAL) {
-      or_response = {m_engine.search(
-          tablename, {constraint_key.column_name, constraint_key.value},
-          joined_lambdas, sorted_column_names)};
+      or_response = traced("search", tablename, [&] {
+        return m_engine.search(
+            tablename, {constraint_key.column_name, constraint_key.value},
+            joined_lambdas, sorted_column_names);
+      });
+      add_plan_step(tablename, "search", constraint_key.column_name,
+                    or_response.records.size());
 
     } else {
       Attribute begin_key = DB_ENGINE::KEY_LIMITS::MIN;
@@ -202,88 +928,410 @@ void SqlParser::select(const std::string &tablename,
       case Comp::EQUAL:
         break;
       }
-      or_response = m_engine.range_search(tablename, begin_key, end_key,
-                                          joined_lambdas, sorted_column_names);
+      or_response = traced("range_search", tablename, [&] {
+        return m_engine.range_search(tablename, begin_key, end_key,
+                                     joined_lambdas, sorted_column_names);
+      });
+      add_plan_step(tablename, "range_search", constraint_key.column_name,
+                    or_response.records.size());
     }
 
     query_response.query_times =
         merge_times(query_response.query_times, or_response.query_times);
-    query_response.records =
-        merge_records(query_response.records, or_response.records);
+    {
+      trace_span span("union", "merge");
+      push_rows(or_response.records, merged);
+    }
   }
-  query_to_output(query_response, sorted_column_names);
+  return query_response;
 }
 
-void SqlParser::query_to_output(
-    const DB_ENGINE::QueryResponse &query_response,
-    const std::vector<std::string> &sorted_column_names) {
-  m_parser_response.records = query_response.records;
-  m_parser_response.query_times = query_response.query_times;
-  m_parser_response.table_names = m_engine.get_table_names();
-  m_parser_response.column_names = sorted_column_names;
-}
+auto SqlParser::late_select(
+    const std::string &tablename,
+    const std::vector<std::string> &sorted_column_names,
+    const std::list<condition_t> &conditions,
+    const std::function<bool(const Record &)> &predicate,
+    QueryResponse &query_response) -> bool {
+  const auto &info = table_info(tablename);
 
-auto SqlParser::merge_records(const std::vector<Record> &vec1,
-                              const std::vector<Record> &vec2)
-    -> std::vector<Record> {
+  // The first index column identifies the rows to fetch later
+  std::vector<std::string> narrow;
+  if (!info.indexes.empty()) {
+    narrow.push_back(info.indexes.front());
+  }
+  for (const auto &condition : conditions) {
+    if (std::ranges::find(narrow, condition.column_name) == narrow.end()) {
+      narrow.push_back(condition.column_name);
+    }
+  }
+  const bool covered =
+      std::ranges::all_of(sorted_column_names, [&](const auto &column) {
+        return std::ranges::find(narrow, column) != narrow.end();
+      });
+  if (narrow.size() >= info.attributes.size() ||
+      (!covered && info.indexes.empty())) {
+    return false;
+  }
+
+  // Estimated before scanning from what the filter matched last time, one
+  // never run is taken as selective when it compares for equality. Only
+  // fetching by key depends on it, a covered projection needs no fetch.
+  const auto shape = filter_shape(tablename, conditions);
+  const auto known = m_match_ratio.find(shape);
+  const bool selective =
+      known != m_match_ratio.end()
+          ? known->second * LATE_FETCH_RATIO <= 1
+          : std::ranges::any_of(conditions, [](const auto &condition) {
+              return condition.c == Comp::EQUAL;
+            });
+  if (!covered && !selective) {
+    return false;
+  }
 
-  std::vector<Record> response;
-  response.reserve(vec1.size() + vec2.size());
+  narrow = traced("sort_attributes", tablename, [&] {
+    return m_engine.sort_attributes(tablename, narrow);
+  });
+  auto position = [&](const std::string &column) {
+    return static_cast<std::size_t>(std::ranges::find(narrow, column) -
+                                    narrow.begin());
+  };
+  std::vector<std::size_t> table_positions;
+  for (const auto &column : narrow) {
+    table_positions.push_back(static_cast<std::size_t>(
+        std::ranges::find(info.attributes, column) - info.attributes.begin()));
+  }
 
-  response.insert(response.end(), vec1.begin(), vec1.end());
+  auto rows = traced("load", tablename,
+                     [&] { return m_engine.load(tablename, narrow); });
+  add_plan_step(tablename, "load", {}, rows.records.size());
+  const std::size_t scanned = rows.records.size();
+  m_table_rows[tablename] = scanned;
+  const auto filter = widen_predicate(predicate, std::move(table_positions),
+                                      info.attributes.size());
 
-  std::unordered_set<Record, RecordHash> unique_elements(vec1.begin(),
-                                                         vec1.end());
+  if (covered) {
+    std::vector<std::size_t> columns;
+    for (const auto &column : sorted_column_names) {
+      columns.push_back(position(column));
+    }
+    query_response.query_times = std::move(rows.query_times);
+    query_response.records =
+        filter_project(std::move(rows.records), filter, columns);
+    return true;
+  }
 
-  for (const auto &element : vec2) {
-    if (unique_elements.find(element) == unique_elements.end()) {
-      response.push_back(element);
-      unique_elements.insert(element);
+  const auto &key_column = info.indexes.front();
+  const std::array key_position{position(key_column)};
+  auto keys = filter_project(std::move(rows.records), filter, key_position);
+  // In scan order, so rows come back in the order a full scan returns them
+  std::unordered_set<std::string> seen;
+  std::vector<std::string> distinct;
+  for (auto &key : keys) {
+    if (seen.insert(key.m_fields.front()).second) {
+      distinct.push_back(std::move(key.m_fields.front()));
     }
   }
+  m_match_ratio[shape] =
+      scanned == 0 ? 0
+                   : static_cast<double>(distinct.size()) /
+                         static_cast<double>(scanned);
+  if (distinct.size() * LATE_FETCH_RATIO > scanned) {
+    // Only the first time for this shape, the estimate now says so
+    spdlog::info("{} of {} rows match, scanning all columns",
+                 distinct.size(), scanned);
+    return false;
+  }
+
+  // The engine checks the whole filter again on the complete rows
+  query_response.query_times = std::move(rows.query_times);
+  trace_span span("fetch", "execute", tablename);
+  for (const auto &key : distinct) {
+    auto found = traced("search", tablename, [&] {
+      return m_engine.search(tablename, {key_column, key}, predicate,
+                             sorted_column_names);
+    });
+    merge_times(query_response.query_times, found.query_times);
+    std::ranges::move(found.records,
+                      std::back_inserter(query_response.records));
+  }
+  add_plan_step(tablename, "search", key_column,
+                query_response.records.size(), distinct.size());
+  return true;
+}
+
+void SqlParser::query_to_output(
+    const std::string &tablename, DB_ENGINE::QueryResponse &&query_response,
+    const std::vector<std::string> &sorted_column_names) {
+  // The engine hands over fresh vectors, take them instead of copying.
+  // Names are assigned so the response's strings keep their capacity.
+  m_parser_response.records.swap(query_response.records);
+  m_parser_response.query_times.swap(query_response.query_times);
+  if (!m_table_names_valid) {
+    m_table_names = traced("get_table_names", {},
+                           [&] { return m_engine.get_table_names(); });
+    m_table_names_valid = true;
+  }
+  m_parser_response.table_names = m_table_names;
+  m_parser_response.column_names = sorted_column_names;
+  m_statement.rows_returned = m_parser_response.records.size();
+
+  if (!m_export_path.empty()) {
+    trace_span span("write_arrow_file", "output", m_export_path);
+    const auto bytes =
+        write_arrow_file(m_export_path, m_parser_response.records,
+                         sorted_column_names,
+                         column_types(tablename, sorted_column_names));
+    m_statement.bytes_written += bytes;
+    m_parser_response.text =
+        fmt::format("{} rows, {} bytes written to {}\n",
+                    m_parser_response.records.size(), bytes, m_export_path);
+    m_parser_response.records.clear();
+    m_export_path.clear();
+  } else if (m_columnar) {
+    to_columnar(m_parser_response.records, sorted_column_names,
+                column_types(tablename, sorted_column_names),
+                m_parser_response.columns, true);
+    m_parser_response.records.clear();
+  }
+}
 
-  return response;
+auto SqlParser::column_types(const std::string &tablename,
+                             const std::vector<std::string> &column_names)
+    -> std::vector<std::optional<column_type_t>> {
+  std::vector<std::optional<column_type_t>> types(column_names.size());
+  const auto known = m_column_types.find(tablename);
+  if (known == m_column_types.end()) {
+    return types;
+  }
+  for (std::size_t i = 0; i < types.size(); ++i) {
+    const auto type = known->second.find(column_names[i]);
+    if (type != known->second.end()) {
+      types[i] = type->second;
+    }
+  }
+  return types;
 }
 
 auto SqlParser::merge_times(query_time_t &times_1, const query_time_t &times_2)
     -> query_time_t & {
+  trace_span span("merge_times", "merge");
   times_1.insert(times_2.begin(), times_2.end());
   return times_1;
 }
 
 void SqlParser::insert_from_file(const std::string &tablename,
                                  const std::string &filename) {
+  trace_span span("insert_from_file", "grammar", tablename);
+  auto phases = start_phase(phase_t::EXECUTE);
+  set_statement("insert", tablename);
+  wait_index_build(tablename);
+  flush_inserts();
   auto file_name = filename.substr(1, filename.length() - 2);
-  m_engine.csv_insert(tablename, file_name);
+  if (bulk_reader::is_bulk_file(file_name)) {
+    insert_bulk(tablename, file_name);
+    return;
+  }
+  traced("csv_insert", tablename,
+         [&] { m_engine.csv_insert(tablename, file_name); });
+
+  std::error_code error;
+  const auto file_size = std::filesystem::file_size(file_name, error);
+  m_statement.bytes_written += error ? 0 : file_size;
+}
+
+void SqlParser::insert_bulk(const std::string &tablename,
+                            const std::string &file_name) {
+  const bulk_reader reader(file_name);
+  const auto &columns = reader.columns();
+
+  // Columns must be the table's, in its order, and agree with the types
+  // this session created it with
+  const auto &info = table_info(tablename);
+  const auto known_types = m_column_types.find(tablename);
+  bool matches = columns.size() == info.attributes.size();
+  for (std::size_t i = 0; matches && i < columns.size(); ++i) {
+    matches = columns[i].name == info.attributes[i];
+    if (matches && known_types != m_column_types.end()) {
+      const auto type = known_types->second.find(columns[i].name);
+      matches = type == known_types->second.end() ||
+                type->second == to_column_type(columns[i].type);
+    }
+  }
+  if (!matches) {
+    spdlog::error("Columns of {} don't match table {}", file_name, tablename);
+    throw std::runtime_error("Bulk file doesn't match the table");
+  }
+
+  // Sorted on the first index so its inserts walk the keys in order
+  std::vector<std::size_t> order(reader.row_count());
+  std::iota(order.begin(), order.end(), 0);
+  if (!info.indexes.empty()) {
+    const auto key = std::ranges::find_if(columns, [&](const auto &column) {
+      return column.name == info.indexes.front();
+    });
+    if (key != columns.end()) {
+      const auto key_column =
+          static_cast<std::size_t>(key - columns.begin());
+      std::ranges::stable_sort(order, [&](std::size_t a, std::size_t b) {
+        return reader.less(key_column, a, b);
+      });
+    }
+  }
+
+  trace_span span("add", "engine", tablename);
+  std::vector<std::string> values;
+  for (const auto row : order) {
+    reader.row_values(row, values);
+    m_engine.add(tablename, {values.begin(), values.end()});
+  }
+  m_statement.bytes_written += reader.file_size();
 }
 
 void SqlParser::insert(const std::string &tablename,
                        const std::vector<std::string> &values) {
+  trace_span span("insert", "grammar", tablename);
+  auto phases = start_phase(phase_t::EXECUTE);
+  set_statement("insert", tablename);
+  for (const auto &value : values) {
+    m_statement.bytes_written += value.size();
+  }
+  if (log_side_write(tablename, {{values.rbegin(), values.rend()}, {}})) {
+    return;
+  }
+  if (m_batch_rows == 0) {
+    traced("add", tablename, [&] {
+      m_engine.add(tablename, {values.rbegin(), values.rend()});
+    });
+    return;
+  }
+
+  auto &batch = m_insert_batches[tablename];
+  batch.rows.emplace_back(values.rbegin(), values.rend());
+  batch.queued.push_back(std::chrono::steady_clock::now());
+  ++m_pending_rows;
+  if (batch.rows.size() >= m_batch_rows) {
+    apply_insert_batch(tablename, batch);
+  }
+}
+
+void SqlParser::set_insert_batching(std::size_t max_rows,
+                                    std::chrono::milliseconds max_delay) {
+  flush_inserts();
+  m_batch_rows = max_rows;
+  m_batch_delay = max_delay;
+}
+
+auto SqlParser::flush_due_inserts() -> std::chrono::steady_clock::time_point {
+  const auto now = std::chrono::steady_clock::now();
+  auto next = std::chrono::steady_clock::time_point::max();
+  for (auto &[tablename, batch] : m_insert_batches) {
+    if (batch.queued.empty()) {
+      continue;
+    }
+    const auto due = batch.queued.front() + m_batch_delay;
+    if (due <= now) {
+      apply_insert_batch(tablename, batch);
+    } else {
+      next = std::min(next, due);
+    }
+  }
+  return next;
+}
+
+void SqlParser::flush_inserts() {
+  for (auto &[tablename, batch] : m_insert_batches) {
+    if (!batch.rows.empty()) {
+      apply_insert_batch(tablename, batch);
+    }
+  }
+}
+
+void SqlParser::apply_insert_batch(const std::string &tablename,
+                                   insert_batch_t &batch) {
+  // Taken out first so a row the engine rejects doesn't get the batch
+  // applied again by the next flush
+  auto rows = std::move(batch.rows);
+  auto queued = std::move(batch.queued);
+  batch.rows.clear();
+  batch.queued.clear();
+  m_pending_rows -= rows.size();
+
+  // Sorted on the first index, as bulk loads are, so its inserts walk the
+  // keys in order
+  const auto &info = table_info(tablename);
+  std::vector<std::size_t> order(rows.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (!info.indexes.empty()) {
+    const auto key = std::ranges::find(info.attributes, info.indexes.front());
+    const auto key_column =
+        static_cast<std::size_t>(key - info.attributes.begin());
+    if (key != info.attributes.end() &&
+        std::ranges::all_of(rows, [&](const auto &row) {
+          return key_column < row.size();
+        })) {
+      std::ranges::stable_sort(order, [&](std::size_t a, std::size_t b) {
+        return value_less(rows[a][key_column], rows[b][key_column]);
+      });
+    }
+  }
+
+  {
+    trace_span span("add", "engine", tablename);
+    for (const auto row : order) {
+      m_engine.add(tablename, {rows[row].begin(), rows[row].end()});
+    }
+  }
 
-  m_engine.add(tablename, {values.rbegin(), values.rend()});
+  const auto applied = std::chrono::steady_clock::now();
+  auto &metrics = metrics_registry::instance();
+  metrics.record_ingest_batch(rows.size());
+  for (const auto time : queued) {
+    metrics.record_ingest_lag(applied - time);
+  }
 }
 
 void SqlParser::remove(const std::string &tablename,
                        std::list<std::list<condition_t>> &constraint) {
+  trace_span span("remove", "grammar", tablename);
+  auto phases = start_phase(phase_t::EXECUTE);
+  set_statement("delete", tablename);
   Attribute key;
   condition_t &unique_condition = constraint.front().front();
   key.name = unique_condition.column_name;
   key.value = unique_condition.value;
-  m_engine.remove(tablename, key);
+  if (log_side_write(tablename, {{}, key})) {
+    return;
+  }
+  traced("remove", tablename, [&] { m_engine.remove(tablename, key); });
 }
 
 void SqlParser::drop_table(const std::string &tablename) {
-  m_engine.drop_table(tablename);
+  trace_span span("drop_table", "grammar", tablename);
+  auto phases = start_phase(phase_t::EXECUTE);
+  set_statement("drop_table", tablename);
+  wait_index_build(tablename);
+  m_catalog.erase(tablename);
+  m_column_types.erase(tablename);
+  m_table_rows.erase(tablename);
+  m_table_names_valid = false;
+  std::lock_guard lock(catalog_mutex());
+  traced("drop_table", tablename, [&] { m_engine.drop_table(tablename); });
+  schema_changed();
 }
 
 void SqlParser::select_between(const std::string &tablename,
                                const std::vector<std::string> &column_names,
                                const std::string &id, const std::string &val1,
                                const std::string &val2) {
+  trace_span span("select_between", "grammar", tablename);
+  auto phases = start_phase(phase_t::PLAN);
+  set_statement("select", tablename);
   auto sorted_column_names = column_names;
-  m_engine.sort_attributes(tablename, sorted_column_names);
+  traced("sort_attributes", tablename, [&] {
+    return m_engine.sort_attributes(tablename, sorted_column_names);
+  });
 
-  auto table_attributes = this->m_engine.get_table_attributes(tablename);
+  const auto &table_attributes = table_info(tablename).attributes;
 
   QueryResponse query_response;
 
@@ -299,8 +1347,13 @@ void SqlParser::select_between(const std::string &tablename,
   Attribute begin_key = {id, val1};
   Attribute end_key = {id, val2};
 
-  query_response = m_engine.range_search(tablename, begin_key, end_key, {},
-                                         sorted_column_names);
+  phases.enter(phase_t::EXECUTE);
+  query_response = traced("range_search", tablename, [&] {
+    return m_engine.range_search(tablename, begin_key, end_key, {},
+                                 sorted_column_names);
+  });
+  add_plan_step(tablename, "range_search", id, query_response.records.size());
 
-  query_to_output(query_response, sorted_column_names);
+  phases.enter(phase_t::OUTPUT);
+  query_to_output(tablename, std::move(query_response), sorted_column_names);
 }
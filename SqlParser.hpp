@@ -1,16 +1,33 @@
 #ifndef SQL_PARSER_HPP
 #define SQL_PARSER_HPP
 
+#include <atomic>
+#include <chrono>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
 #include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "Record/Record.hpp"
+#include "columnar.hpp"
+#include "histogram.hpp"
 #include "parser.tab.hh"
+#include "perf_counters.hpp"
+#include "point_query.hpp"
+#include "query_stats.hpp"
 #include "scanner.hpp"
+#include "slow_query_log.hpp"
+#include "workload_capture.hpp"
 
 struct ParserResponse {
   std::vector<Record> records;
@@ -19,15 +36,34 @@ struct ParserResponse {
   std::vector<std::string> table_names;
   std::string error;
   int code = 200;
+  uint64_t fingerprint = 0; // Of the last statement, literals normalized out
+  statement_stats_t stats;  // Of the last statement
+  std::string text;         // From EXPLAIN ANALYZE, SHOW METRICS and exports
+  // Filled instead of records in columnar mode
+  columnar_result_t columns;
   void clear() {
     records.clear();
+    columns.clear();
     query_times.clear();
     column_names.clear();
     table_names.clear();
+    fingerprint = 0;
+    stats.clear();
+    text.clear();
   }
   auto failed() const -> bool { return code != 200; }
 };
 
+// Aggregated over every execution of one statement fingerprint
+struct fingerprint_stats_t {
+  histogram latency_ns;
+  histogram rows;
+};
+
+// Fingerprints a session keeps stats for, the least recently run is dropped
+// past this. About 15 KB each.
+constexpr std::size_t MAX_FINGERPRINTS = 256;
+
 class SqlParser {
 public:
   SqlParser() = default;
@@ -48,6 +84,10 @@ public:
 
   auto parse(std::istream &stream) -> ParserResponse &;
 
+  // Parses a query held in memory, single-row lookups on an indexed column
+  // skip the bison parser entirely
+  auto parse_query(std::string_view query) -> ParserResponse &;
+
   void check_table_name(const std::string &tablename);
 
   void create_table(const std::string &tablename,
@@ -57,6 +97,21 @@ public:
                     const std::string &column_name,
                     const DB_ENGINE::DBEngine::Index_t &index_name);
 
+  // CREATE INDEX CONCURRENTLY, built by its own engine instance on a thread
+  // of its own. Until then every session's writes to the table go to a side
+  // log and the planner ignores the index, both are settled at the first
+  // statement boundary after the build. A session reading a table it has
+  // logged writes to waits for the build first, so it sees its writes.
+  // DBEngine::create_index builds and writes the catalog in one call, so
+  // other schema changes wait for it, and writes from other processes
+  // aren't logged: build concurrently from one process only.
+  void create_index_concurrently(
+      const std::string &tablename, const std::string &column_name,
+      const DB_ENGINE::DBEngine::Index_t &index_name);
+
+  // Waits for the background index builds and applies their side logs
+  void finish_index_builds() { settle_index_builds(true); }
+
   void select(const std::string &tablename,
               const std::vector<std::string> &column_names,
               const std::list<std::list<condition_t>> &constraints);
@@ -77,21 +132,199 @@ public:
 
   void drop_table(const std::string &tablename);
 
+  // Buffers INSERT ... VALUES per table and applies them in micro-batches of
+  // max_rows rows, or once the oldest row has waited max_delay. Any other
+  // statement applies the pending rows first. 0 rows turns batching off.
+  void set_insert_batching(std::size_t max_rows,
+                           std::chrono::milliseconds max_delay);
+
+  // Applies the batches that are due, returns when the next one will be
+  auto flush_due_inserts() -> std::chrono::steady_clock::time_point;
+
+  void flush_inserts();
+
+  // SELECT results come back in ParserResponse::columns, typed from the
+  // CREATE TABLE when this session ran it and inferred otherwise. Strings
+  // that repeat are dictionary encoded.
+  void set_columnar(bool enabled) { m_columnar = enabled; }
+
+  // COPY t TO 'file.csv' [WHERE ...], formatting rows on every core
+  void copy_to(const std::string &tablename, const std::string &filename,
+               const std::list<std::list<condition_t>> &constraints);
+
+  // Called by the grammar once a statement's ';' has been consumed
+  void end_statement();
+
+  // Called by the grammar before the SELECT of an EXPLAIN ANALYZE runs
+  void explain_next();
+
+  // Called by the grammar before a SELECT ... INTO ARROW 'file' runs, its
+  // result goes to the file instead of the response
+  void export_next(const std::string &filename);
+
+  // SHOW METRICS, the process-wide metrics in Prometheus text format
+  void show_metrics();
+
+  // Collects hardware counters per phase. They count the calling thread, so
+  // this must be called from the thread that runs the session's queries.
+  void enable_perf_counters(bool enabled);
+
+  // Statements slower than the log's threshold are written to it, the log
+  // may be shared between sessions
+  void set_slow_query_log(std::shared_ptr<slow_query_log> log) {
+    m_slow_log = std::move(log);
+  }
+
+  // Every statement of this session is recorded under session_id, failed
+  // ones included
+  void set_workload_capture(std::shared_ptr<workload_capture> capture,
+                            uint64_t session_id) {
+    m_capture = std::move(capture);
+    m_session_id = session_id;
+  }
+
+  // Only the MAX_FINGERPRINTS most recently run fingerprints are kept,
+  // nullptr for any other
+  auto get_fingerprint_stats(uint64_t fingerprint) const
+      -> const fingerprint_stats_t *;
+
 private:
+  struct table_info_t {
+    std::vector<std::string> attributes;
+    std::vector<std::string> indexes;
+  };
+
+  struct insert_batch_t {
+    std::vector<std::vector<std::string>> rows; // Values in table order
+    std::vector<std::chrono::steady_clock::time_point> queued;
+  };
+
+  // A write made while an index of its table was being built
+  struct side_write_t {
+    std::vector<std::string> values; // In table order, empty for a remove
+    DB_ENGINE::Attribute key;
+  };
+
+  struct index_build_t {
+    std::string column;
+    std::shared_future<void> done;
+    std::mutex mutex; // Guards side_log and applied
+    std::vector<side_write_t> side_log;
+    bool applied = false;
+  };
+
+  // The builds running in this process, by table. Every session's writes to
+  // such a table go to the build's side log, and whichever session finds
+  // the build done first applies it.
+  struct build_registry_t {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<index_build_t>> builds;
+    std::atomic<std::size_t> count{0};
+  };
+  static auto index_builds() -> build_registry_t &;
+
   DB_ENGINE::DBEngine m_engine;
   ParserResponse m_parser_response;
 
-  void query_to_output(const DB_ENGINE::QueryResponse &query_response,
+  // Catalog cache, entries are dropped whenever the table's schema changes.
+  // All of it is dropped when another session or process changed a schema,
+  // seen as a new catalog generation or a new meta.data write time.
+  std::unordered_map<std::string, table_info_t> m_catalog;
+  std::vector<std::string> m_table_names;
+  bool m_table_names_valid = false;
+  uint64_t m_catalog_generation = 0;
+  std::filesystem::file_time_type m_catalog_written;
+  std::vector<std::size_t> m_merge_slots;
+  // Rows each table had in its last full scan, an estimate for planning
+  std::unordered_map<std::string, std::size_t> m_table_rows;
+  // Share of rows each filter shape matched in its last late_select scan
+  std::unordered_map<std::string, double> m_match_ratio;
+  bool m_columnar = false;
+  std::string m_export_path;
+  std::unordered_map<std::string,
+                     std::unordered_map<std::string, column_type_t>>
+      m_column_types;
+  point_query_t m_point_query;
+
+  std::unordered_map<std::string, insert_batch_t> m_insert_batches;
+  std::size_t m_pending_rows = 0;
+  std::size_t m_batch_rows = 0;
+  std::chrono::milliseconds m_batch_delay{0};
+
+  struct fingerprint_entry_t {
+    uint64_t fingerprint = 0;
+    fingerprint_stats_t stats;
+  };
+  // Most recently run first, each entry holds two histograms
+  std::list<fingerprint_entry_t> m_fingerprint_stats;
+  std::unordered_map<uint64_t, std::list<fingerprint_entry_t>::iterator>
+      m_fingerprint_entries;
+  std::chrono::steady_clock::time_point m_statement_start;
+  statement_stats_t m_statement;
+  std::unique_ptr<perf_counters> m_perf_counters;
+  counter_values_t m_statement_counters{};
+  alloc_counters_t m_statement_allocs{};
+  bool m_explain = false;
+  std::shared_ptr<slow_query_log> m_slow_log;
+  std::shared_ptr<workload_capture> m_capture;
+  uint64_t m_session_id = 0;
+
+  void start_statement();
+  void refresh_catalog();
+  void schema_changed();
+  auto start_phase(phase_t phase) -> phase_timer;
+  void record_statement(uint64_t fingerprint, std::string_view text);
+  auto fingerprint_stats(uint64_t fingerprint) -> fingerprint_stats_t &;
+  void capture_failed(std::string_view text);
+  void set_statement(std::string_view type, const std::string &tablename);
+  // probes is only counted with an index column
+  void add_plan_step(const std::string &tablename, std::string access,
+                     std::string index_column, std::size_t rows,
+                     std::size_t probes = 1);
+
+  auto table_info(const std::string &tablename) -> const table_info_t &;
+  void check_index_column(const std::string &tablename,
+                          const std::string &column_name);
+  // Applies the finished builds, or all of them after waiting when wait
+  void settle_index_builds(bool wait);
+  void wait_index_build(const std::string &tablename);
+  void apply_index_build(const std::string &tablename, index_build_t &build);
+  static auto find_index_build(const std::string &tablename)
+      -> std::shared_ptr<index_build_t>;
+  // Logs the write when tablename has a build running, false otherwise
+  auto log_side_write(const std::string &tablename, side_write_t &&write)
+      -> bool;
+  void insert_bulk(const std::string &tablename, const std::string &file_name);
+  void apply_insert_batch(const std::string &tablename,
+                          insert_batch_t &batch);
+  // Plans and runs a SELECT's OR branches, checking the columns first
+  auto run_select(const std::string &tablename,
+                  const std::vector<std::string> &sorted_column_names,
+                  const std::list<std::list<condition_t>> &constraints,
+                  phase_timer &phases) -> DB_ENGINE::QueryResponse;
+  // Full scans with a selective filter: scans the filter's columns and an
+  // index column, then fetches the projected columns for the matching keys.
+  // False when that can't pay off, the caller scans as usual then.
+  auto late_select(const std::string &tablename,
+                   const std::vector<std::string> &sorted_column_names,
+                   const std::list<condition_t> &conditions,
+                   const std::function<bool(const Record &)> &predicate,
+                   DB_ENGINE::QueryResponse &query_response) -> bool;
+  auto column_types(const std::string &tablename,
+                    const std::vector<std::string> &column_names)
+      -> std::vector<std::optional<column_type_t>>;
+  auto try_point_query(std::string_view query) -> bool;
+
+  void query_to_output(const std::string &tablename,
+                       DB_ENGINE::QueryResponse &&query_response,
                        const std::vector<std::string> &sorted_column_names);
-  void parse_helper(std::istream &stream);
+  // query is the statement's text when the caller has it, a failure is
+  // captured with it instead of with what was lexed
+  void parse_helper(std::istream &stream, std::string_view query = {});
   std::unordered_set<std::string> m_tablenames;
   yy::parser *m_parser = nullptr;
   scanner *m_sc = nullptr;
 
-  static auto merge_records(const std::vector<Record> &vec1,
-                            const std::vector<Record> &vec2)
-      -> std::vector<Record>;
-
   static auto merge_times(query_time_t &times_1, const query_time_t &times_2)
       -> query_time_t &;
 };
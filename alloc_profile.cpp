@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#include "alloc_profile.hpp"
+
+// Replaces the global allocation functions for the whole program, counting
+// into trivially initialized thread locals so no allocation happens here
+
+constinit thread_local alloc_counters_t thread_alloc_counters{};
+
+namespace {
+
+auto counted(void *ptr) -> void * {
+  auto &counters = thread_alloc_counters;
+  const auto size = malloc_usable_size(ptr);
+  ++counters.allocations;
+  counters.bytes += size;
+  counters.live += static_cast<int64_t>(size);
+  if (counters.live > counters.statement_peak) {
+    counters.statement_peak = counters.live;
+  }
+  if (counters.live > counters.phase_peak) {
+    counters.phase_peak = counters.live;
+  }
+  return ptr;
+}
+
+auto allocate(std::size_t size) -> void * {
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  return ptr == nullptr ? nullptr : counted(ptr);
+}
+
+auto allocate(std::size_t size, std::align_val_t alignment) -> void * {
+  const auto align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a multiple of the alignment
+  const std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) &
+                              ~(align - 1);
+  void *ptr = std::aligned_alloc(align, rounded);
+  return ptr == nullptr ? nullptr : counted(ptr);
+}
+
+void deallocate(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  thread_alloc_counters.live -= static_cast<int64_t>(malloc_usable_size(ptr));
+  std::free(ptr);
+}
+
+} // namespace
+
+auto operator new(std::size_t size) -> void * {
+  void *ptr = allocate(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+auto operator new[](std::size_t size) -> void * { return operator new(size); }
+
+auto operator new(std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+    -> void * {
+  return allocate(size);
+}
+
+auto operator new[](std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+    -> void * {
+  return allocate(size);
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void * {
+  void *ptr = allocate(size, alignment);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void * {
+  return operator new(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr) noexcept { deallocate(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/) noexcept {
+  deallocate(ptr);
+}
+void operator delete[](void *ptr, std::size_t /*size*/) noexcept {
+  deallocate(ptr);
+}
+void operator delete(void *ptr, std::align_val_t /*alignment*/) noexcept {
+  deallocate(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t /*alignment*/) noexcept {
+  deallocate(ptr);
+}
+void operator delete(void *ptr, std::size_t /*size*/,
+                     std::align_val_t /*alignment*/) noexcept {
+  deallocate(ptr);
+}
+void operator delete[](void *ptr, std::size_t /*size*/,
+                       std::align_val_t /*alignment*/) noexcept {
+  deallocate(ptr);
+}
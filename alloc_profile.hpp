@@ -0,0 +1,50 @@
+#ifndef ALLOC_PROFILE_HPP
+#define ALLOC_PROFILE_HPP 1
+
+#include <cstdint>
+
+// Heap activity of the calling thread, counted by the replacement operator
+// new/delete of alloc_profile.cpp. Only compiled in with the
+// SQLPARSER_ALLOC_PROFILE option, otherwise every counter stays at zero.
+struct alloc_counters_t {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;         // Usable size of every allocation
+  int64_t live = 0;           // Negative when freeing other threads' memory
+  int64_t statement_peak = 0; // Highest live since alloc_mark_statement
+  int64_t phase_peak = 0;     // Highest live since alloc_mark_phase
+};
+
+// What one statement or phase allocated
+struct alloc_stats_t {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+  uint64_t peak_bytes = 0; // Above what was live when it started
+};
+
+#ifdef SQLPARSER_ALLOC_PROFILE
+
+constexpr bool ALLOC_PROFILING = true;
+
+extern constinit thread_local alloc_counters_t thread_alloc_counters;
+
+inline auto alloc_counters() -> const alloc_counters_t & {
+  return thread_alloc_counters;
+}
+inline void alloc_mark_statement() {
+  thread_alloc_counters.statement_peak = thread_alloc_counters.live;
+}
+inline void alloc_mark_phase() {
+  thread_alloc_counters.phase_peak = thread_alloc_counters.live;
+}
+
+#else
+
+constexpr bool ALLOC_PROFILING = false;
+
+inline auto alloc_counters() -> alloc_counters_t { return {}; }
+inline void alloc_mark_statement() {}
+inline void alloc_mark_phase() {}
+
+#endif // SQLPARSER_ALLOC_PROFILE
+
+#endif // ALLOC_PROFILE_HPP
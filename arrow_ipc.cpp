@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <span>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#include "arrow_ipc.hpp"
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+constexpr uint32_t CONTINUATION = 0xFFFFFFFF;
+constexpr int16_t METADATA_V5 = 4;
+constexpr std::size_t BODY_ALIGNMENT = arrow_buffer::ALIGNMENT;
+
+// Message.fbs MessageHeader and Schema.fbs Type union tags
+enum : uint8_t { HEADER_SCHEMA = 1, HEADER_RECORD_BATCH = 3 };
+enum : uint8_t { TYPE_INT = 2, TYPE_FLOAT = 3, TYPE_UTF8 = 5, TYPE_BOOL = 6 };
+constexpr int16_t PRECISION_DOUBLE = 2;
+
+// Builds a flatbuffer back to front like the flatbuffers library does:
+// children are written before the tables pointing at them, and every offset
+// is kept as the distance from the end of the buffer. Assumes a little
+// endian host, as the rest of the file format does.
+class flatbuffer_builder {
+public:
+  using offset_t = uint32_t;
+
+  template <typename T> void prepend(T value) {
+    align(sizeof(T));
+    prepend_bytes(&value, sizeof(T));
+  }
+
+  void prepend_offset(offset_t target) {
+    align(sizeof(offset_t));
+    prepend(static_cast<offset_t>(m_size + sizeof(offset_t) - target));
+  }
+
+  auto create_string(std::string_view text) -> offset_t {
+    align_after(text.size() + 1, sizeof(offset_t));
+    prepend<uint8_t>(0);
+    prepend_bytes(text.data(), text.size());
+    prepend(static_cast<uint32_t>(text.size()));
+    return m_size;
+  }
+
+  auto create_offsets(const std::vector<offset_t> &targets) -> offset_t {
+    align_after(targets.size() * sizeof(offset_t), sizeof(offset_t));
+    for (auto it = targets.rbegin(); it != targets.rend(); ++it) {
+      prepend_offset(*it);
+    }
+    prepend(static_cast<uint32_t>(targets.size()));
+    return m_size;
+  }
+
+  // Structs are given as their little endian bytes, 8-byte aligned
+  auto create_structs(std::span<const uint8_t> bytes, std::size_t count)
+      -> offset_t {
+    align_after(bytes.size(), sizeof(uint64_t));
+    prepend_bytes(bytes.data(), bytes.size());
+    prepend(static_cast<uint32_t>(count));
+    return m_size;
+  }
+
+  void start_table() {
+    m_fields.clear();
+    m_table_end = m_size;
+  }
+
+  template <typename T> void add_scalar(uint16_t field, T value) {
+    prepend(value);
+    m_fields.emplace_back(field, m_size);
+  }
+
+  void add_offset(uint16_t field, offset_t target) {
+    prepend_offset(target);
+    m_fields.emplace_back(field, m_size);
+  }
+
+  auto end_table() -> offset_t {
+    prepend<int32_t>(0); // Distance to the vtable, patched below
+    const offset_t table = m_size;
+
+    uint16_t field_count = 0;
+    for (const auto &[field, position] : m_fields) {
+      field_count = std::max<uint16_t>(field_count, field + 1);
+    }
+    std::vector<uint16_t> vtable(field_count, 0);
+    for (const auto &[field, position] : m_fields) {
+      vtable[field] = static_cast<uint16_t>(table - position);
+    }
+    for (auto it = vtable.rbegin(); it != vtable.rend(); ++it) {
+      prepend(*it);
+    }
+    prepend(static_cast<uint16_t>(table - m_table_end));
+    prepend(static_cast<uint16_t>(sizeof(uint16_t) * (2 + field_count)));
+
+    const auto to_vtable = static_cast<int32_t>(m_size - table);
+    std::memcpy(at(table), &to_vtable, sizeof(to_vtable));
+    return table;
+  }
+
+  auto finish(offset_t root) -> std::vector<uint8_t> {
+    align_after(sizeof(offset_t), m_max_align);
+    prepend_offset(root);
+    return {m_buffer.end() - static_cast<std::ptrdiff_t>(m_size),
+            m_buffer.end()};
+  }
+
+private:
+  auto at(offset_t position) -> uint8_t * {
+    return m_buffer.data() + m_buffer.size() - position;
+  }
+
+  void prepend_bytes(const void *bytes, std::size_t count) {
+    if (m_size + count > m_buffer.size()) {
+      std::vector<uint8_t> grown(std::max(2 * m_buffer.size(), m_size + count));
+      std::copy(m_buffer.end() - static_cast<std::ptrdiff_t>(m_size),
+                m_buffer.end(),
+                grown.end() - static_cast<std::ptrdiff_t>(m_size));
+      m_buffer.swap(grown);
+    }
+    m_size += count;
+    if (count != 0) {
+      std::memcpy(at(m_size), bytes, count);
+    }
+  }
+
+  void align(std::size_t alignment) { align_after(0, alignment); }
+
+  // Pads so that after `count` more bytes the size is a multiple of alignment
+  void align_after(std::size_t count, std::size_t alignment) {
+    m_max_align = std::max(m_max_align, alignment);
+    const std::size_t padding =
+        (alignment - ((m_size + count) % alignment)) % alignment;
+    constexpr std::array<uint8_t, 8> ZEROS{};
+    prepend_bytes(ZEROS.data(), padding);
+  }
+
+  std::vector<uint8_t> m_buffer = std::vector<uint8_t>(1024);
+  std::size_t m_size = 0;
+  std::size_t m_max_align = 1;
+  offset_t m_table_end = 0;
+  std::vector<std::pair<uint16_t, offset_t>> m_fields;
+};
+
+template <typename T> void append_le(std::vector<uint8_t> &bytes, T value) {
+  const auto *raw = reinterpret_cast<const uint8_t *>(&value);
+  bytes.insert(bytes.end(), raw, raw + sizeof(T));
+}
+
+auto build_schema(flatbuffer_builder &builder,
+                  const std::vector<std::string> &names,
+                  const std::vector<column_type_t> &types)
+    -> flatbuffer_builder::offset_t {
+  std::vector<flatbuffer_builder::offset_t> fields;
+  fields.reserve(names.size());
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    const auto name = builder.create_string(names[i]);
+    const auto children = builder.create_offsets({});
+
+    uint8_t type_tag = TYPE_UTF8;
+    builder.start_table();
+    switch (types[i]) {
+    case column_type_t::INT32:
+      type_tag = TYPE_INT;
+      builder.add_scalar<int32_t>(0, 32); // bitWidth
+      builder.add_scalar<uint8_t>(1, 1);  // is_signed
+      break;
+    case column_type_t::FLOAT64:
+      type_tag = TYPE_FLOAT;
+      builder.add_scalar<int16_t>(0, PRECISION_DOUBLE);
+      break;
+    case column_type_t::BOOL:
+      type_tag = TYPE_BOOL;
+      break;
+    case column_type_t::UTF8:
+      break;
+    }
+    const auto type = builder.end_table();
+
+    builder.start_table();
+    builder.add_offset(0, name);
+    builder.add_scalar<uint8_t>(1, 1); // nullable
+    builder.add_scalar<uint8_t>(2, type_tag);
+    builder.add_offset(3, type);
+    builder.add_offset(5, children);
+    fields.push_back(builder.end_table());
+  }
+  const auto field_vector = builder.create_offsets(fields);
+
+  builder.start_table();
+  builder.add_offset(1, field_vector);
+  return builder.end_table();
+}
+
+auto build_message(flatbuffer_builder &builder, uint8_t header_type,
+                   flatbuffer_builder::offset_t header, int64_t body_length)
+    -> std::vector<uint8_t> {
+  builder.start_table();
+  builder.add_scalar<int64_t>(3, body_length);
+  builder.add_offset(2, header);
+  builder.add_scalar<int16_t>(0, METADATA_V5);
+  builder.add_scalar<uint8_t>(1, header_type);
+  return builder.finish(builder.end_table());
+}
+
+auto padded(std::size_t size) -> std::size_t {
+  return (size + BODY_ALIGNMENT - 1) & ~(BODY_ALIGNMENT - 1);
+}
+
+} // namespace
+
+arrow_file_writer::arrow_file_writer(const std::string &path,
+                                     std::vector<std::string> names,
+                                     std::vector<column_type_t> types)
+    : m_out(path, std::ios::binary | std::ios::trunc), m_path(path),
+      m_names(std::move(names)), m_types(std::move(types)) {
+  if (!m_out.good()) {
+    spdlog::error("Failed to open {}", path);
+    throw std::runtime_error("Failed to open arrow file");
+  }
+  write(MAGIC.data(), MAGIC.size());
+
+  flatbuffer_builder builder;
+  const auto schema = build_schema(builder, m_names, m_types);
+  write_message(build_message(builder, HEADER_SCHEMA, schema, 0), {});
+}
+
+arrow_file_writer::~arrow_file_writer() {
+  if (!m_finished) {
+    try {
+      finish();
+    } catch (const std::exception &e) {
+      spdlog::error("Failed to finish {}: {}", m_path, e.what());
+    }
+  }
+}
+
+void arrow_file_writer::write_batch(const columnar_result_t &batch) {
+  if (batch.columns.size() != m_types.size()) {
+    spdlog::error("Batch doesn't match the schema of {}", m_path);
+    throw std::runtime_error("Batch doesn't match the schema");
+  }
+
+  std::vector<uint8_t> nodes;
+  std::vector<uint8_t> buffers;
+  std::vector<const arrow_buffer *> body;
+  int64_t body_length = 0;
+  auto add_buffer = [&](const arrow_buffer &buffer) {
+    append_le<int64_t>(buffers, body_length);
+    append_le<int64_t>(buffers, static_cast<int64_t>(buffer.size()));
+    body.push_back(&buffer);
+    body_length += static_cast<int64_t>(padded(buffer.size()));
+  };
+
+  for (std::size_t i = 0; i < batch.columns.size(); ++i) {
+    const auto &column = batch.columns[i];
+    if (column.encoded) {
+      spdlog::error("Column {} is dictionary encoded, {} needs it plain",
+                    column.name, m_path);
+      throw std::runtime_error("Dictionary encoded column in Arrow file");
+    }
+    if (column.type != m_types[i]) {
+      spdlog::error("Column {} doesn't match the schema of {}", column.name,
+                    m_path);
+      throw std::runtime_error("Batch doesn't match the schema");
+    }
+    append_le<int64_t>(nodes, static_cast<int64_t>(batch.length));
+    append_le<int64_t>(nodes, static_cast<int64_t>(column.null_count));
+    add_buffer(column.validity);
+    if (column.type == column_type_t::UTF8) {
+      add_buffer(column.offsets);
+    }
+    add_buffer(column.values);
+  }
+
+  flatbuffer_builder builder;
+  const auto buffer_vector = builder.create_structs(buffers, body.size());
+  const auto node_vector =
+      builder.create_structs(nodes, batch.columns.size());
+  builder.start_table();
+  builder.add_scalar<int64_t>(0, static_cast<int64_t>(batch.length));
+  builder.add_offset(1, node_vector);
+  builder.add_offset(2, buffer_vector);
+  const auto record_batch = builder.end_table();
+
+  const auto offset = static_cast<int64_t>(m_offset);
+  const auto metadata =
+      build_message(builder, HEADER_RECORD_BATCH, record_batch, body_length);
+  write_message(metadata, body);
+  m_batches.push_back({offset, static_cast<int32_t>(m_offset - offset -
+                                                    body_length),
+                       body_length});
+}
+
+void arrow_file_writer::finish() {
+  m_finished = true;
+
+  // End of stream marker, then the footer readers seek to from the end
+  const std::array<uint32_t, 2> eos{CONTINUATION, 0};
+  write(eos.data(), sizeof(eos));
+
+  std::vector<uint8_t> blocks;
+  for (const auto &block : m_batches) {
+    append_le<int64_t>(blocks, block.offset);
+    append_le<int32_t>(blocks, block.metadata_length);
+    append_le<int32_t>(blocks, 0);
+    append_le<int64_t>(blocks, block.body_length);
+  }
+
+  flatbuffer_builder builder;
+  const auto schema = build_schema(builder, m_names, m_types);
+  const auto batches = builder.create_structs(blocks, m_batches.size());
+  const auto dictionaries = builder.create_structs({}, 0);
+  builder.start_table();
+  builder.add_offset(1, schema);
+  builder.add_offset(2, dictionaries);
+  builder.add_offset(3, batches);
+  builder.add_scalar<int16_t>(0, METADATA_V5);
+  const auto footer = builder.finish(builder.end_table());
+
+  write(footer.data(), footer.size());
+  const auto footer_length = static_cast<int32_t>(footer.size());
+  write(&footer_length, sizeof(footer_length));
+  write(MAGIC.data(), 6);
+
+  m_out.flush();
+  if (!m_out.good()) {
+    spdlog::error("Failed to write {}", m_path);
+    throw std::runtime_error("Failed to write arrow file");
+  }
+}
+
+void arrow_file_writer::write_message(
+    const std::vector<uint8_t> &metadata,
+    const std::vector<const arrow_buffer *> &body) {
+  // Continuation marker and length, then the metadata padded so the body
+  // starts 8-byte aligned
+  const std::size_t padded_length = (metadata.size() + 8 + 7) / 8 * 8 - 8;
+  const uint32_t continuation = CONTINUATION;
+  const auto length = static_cast<int32_t>(padded_length);
+  write(&continuation, sizeof(continuation));
+  write(&length, sizeof(length));
+  write(metadata.data(), metadata.size());
+  pad(padded_length - metadata.size());
+
+  for (const auto *buffer : body) {
+    write(buffer->data(), buffer->size());
+    pad(padded(buffer->size()) - buffer->size());
+  }
+}
+
+void arrow_file_writer::write(const void *bytes, std::size_t count) {
+  m_out.write(static_cast<const char *>(bytes),
+              static_cast<std::streamsize>(count));
+  m_offset += count;
+}
+
+void arrow_file_writer::pad(std::size_t count) {
+  constexpr std::array<char, BODY_ALIGNMENT> ZEROS{};
+  write(ZEROS.data(), count);
+}
+
+auto write_arrow_file(const std::string &path,
+                      const std::vector<DB_ENGINE::Record> &records,
+                      const std::vector<std::string> &names,
+                      std::vector<std::optional<column_type_t>> types,
+                      std::size_t batch_rows) -> uint64_t {
+  types.resize(names.size());
+  infer_column_types(records, types);
+  std::vector<column_type_t> resolved;
+  resolved.reserve(types.size());
+  for (const auto &type : types) {
+    resolved.push_back(*type);
+  }
+
+  arrow_file_writer writer(path, names, resolved);
+  columnar_result_t batch;
+  const std::span<const DB_ENGINE::Record> rows(records);
+  for (std::size_t first = 0; first < rows.size(); first += batch_rows) {
+    to_columnar(rows.subspan(first, std::min(batch_rows, rows.size() - first)),
+                names, types, batch);
+    writer.write_batch(batch);
+  }
+  writer.finish();
+  return writer.bytes_written();
+}
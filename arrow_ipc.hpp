@@ -0,0 +1,61 @@
+#ifndef ARROW_IPC_HPP
+#define ARROW_IPC_HPP 1
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "columnar.hpp"
+
+// Writes an Arrow IPC file (metadata version V5) one record batch at a time,
+// without depending on the Arrow library. The flatbuffers metadata is built
+// by hand, the column buffers are written as they are.
+class arrow_file_writer {
+public:
+  arrow_file_writer(const std::string &path, std::vector<std::string> names,
+                    std::vector<column_type_t> types);
+  ~arrow_file_writer();
+
+  arrow_file_writer(const arrow_file_writer &) = delete;
+  auto operator=(const arrow_file_writer &) -> arrow_file_writer & = delete;
+
+  // The batch's columns must match the names and types given on creation
+  void write_batch(const columnar_result_t &batch);
+
+  // Writes the footer, the file is unreadable until this is called
+  void finish();
+
+  [[nodiscard]] auto bytes_written() const -> uint64_t { return m_offset; }
+
+private:
+  struct block_t {
+    int64_t offset;
+    int32_t metadata_length;
+    int64_t body_length;
+  };
+
+  void write_message(const std::vector<uint8_t> &metadata,
+                     const std::vector<const arrow_buffer *> &body);
+  void write(const void *bytes, std::size_t count);
+  void pad(std::size_t count);
+
+  std::ofstream m_out;
+  std::string m_path;
+  std::vector<std::string> m_names;
+  std::vector<column_type_t> m_types;
+  std::vector<block_t> m_batches;
+  uint64_t m_offset = 0;
+  bool m_finished = false;
+};
+
+// Writes rows as an Arrow IPC file in batches of batch_rows rows. Types that
+// aren't given are inferred over the whole result so every batch agrees.
+auto write_arrow_file(const std::string &path,
+                      const std::vector<DB_ENGINE::Record> &records,
+                      const std::vector<std::string> &names,
+                      std::vector<std::optional<column_type_t>> types,
+                      std::size_t batch_rows = 64 * 1024) -> uint64_t;
+
+#endif // ARROW_IPC_HPP
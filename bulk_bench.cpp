@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+#include "bulk_format.hpp"
+
+// Compares a bulk file with its compressed form: the size of each and how
+// fast each is loaded and scanned the way INSERT ... FROM reads it
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+constexpr int RUNS = 5;
+
+template <typename T> void store(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// An uncompressed table shaped like typical data: ascending ids, prices,
+// long runs of the same flag and a handful of distinct cities
+void generate(const std::string &path, std::size_t rows) {
+  constexpr std::array<std::string_view, 8> CITIES{
+      "Amsterdam", "Berlin", "Lisbon", "Madrid",
+      "Oslo",      "Paris",  "Prague", "Vienna"};
+  constexpr std::size_t FLAG_RUN = 1000;
+
+  std::string out = "SQLBULK1";
+  store(out, uint32_t{4});
+  auto column = [&](DB_ENGINE::Type::types type, uint8_t size,
+                    std::string_view name) {
+    store(out, static_cast<uint8_t>(type));
+    store(out, size);
+    store(out, static_cast<uint16_t>(name.size()));
+    out += name;
+  };
+  column(DB_ENGINE::Type::INT, 4, "id");
+  column(DB_ENGINE::Type::FLOAT, 8, "price");
+  column(DB_ENGINE::Type::BOOL, 1, "active");
+  column(DB_ENGINE::Type::VARCHAR, 16, "city");
+
+  std::string heap;
+  std::vector<uint32_t> offsets;
+  for (const auto city : CITIES) {
+    offsets.push_back(static_cast<uint32_t>(heap.size()));
+    heap += city;
+  }
+  store(out, static_cast<uint64_t>(rows));
+  uint64_t state = 1;
+  for (std::size_t row = 0; row < rows; ++row) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    const auto city = (state >> 33) % CITIES.size();
+    store(out, static_cast<int32_t>(row));
+    store(out, static_cast<double>((state >> 40) % 100000) / 100);
+    store(out, static_cast<uint8_t>(row / FLAG_RUN % 2));
+    store(out, offsets[city]);
+    store(out, static_cast<uint32_t>(CITIES[city].size()));
+  }
+  store(out, static_cast<uint64_t>(heap.size()));
+  out += heap;
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(out.data(), static_cast<std::streamsize>(out.size()));
+  if (!file.good()) {
+    spdlog::error("Failed to write {}", path);
+    throw std::runtime_error("Failed to write bulk file");
+  }
+}
+
+struct timing_t {
+  double load_ms = 0; // Reading and decoding the file
+  double scan_ms = 0; // Spelling every row's values
+};
+
+// Best of RUNS, so the page cache is warm for both files
+auto measure(const std::string &path) -> timing_t {
+  timing_t best{std::numeric_limits<double>::max(),
+                std::numeric_limits<double>::max()};
+  std::vector<std::string> values;
+  for (int run = 0; run < RUNS; ++run) {
+    const auto start = clock::now();
+    const bulk_reader reader(path);
+    const auto loaded = clock::now();
+    for (std::size_t row = 0; row < reader.row_count(); ++row) {
+      reader.row_values(row, values);
+    }
+    const auto scanned = clock::now();
+    const std::chrono::duration<double, std::milli> load = loaded - start;
+    const std::chrono::duration<double, std::milli> scan = scanned - loaded;
+    best.load_ms = std::min(best.load_ms, load.count());
+    best.scan_ms = std::min(best.scan_ms, scan.count());
+  }
+  return best;
+}
+
+auto same_rows(const bulk_reader &a, const bulk_reader &b) -> bool {
+  if (a.row_count() != b.row_count()) {
+    return false;
+  }
+  std::vector<std::string> x;
+  std::vector<std::string> y;
+  for (std::size_t row = 0; row < a.row_count(); ++row) {
+    a.row_values(row, x);
+    b.row_values(row, y);
+    if (x != y) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(const int argc, const char **argv) {
+  if (argc < 2) {
+    std::cout << "usage: sql_bulk_bench <file.bin> [rows]\n";
+    std::cout << "  compresses file.bin to file.bin.z and times loading and "
+                 "scanning both\n";
+    std::cout << "  with rows, file.bin is first generated with that many "
+                 "rows\n";
+    return EXIT_FAILURE;
+  }
+  const std::string path = argv[1];
+  const std::string compressed_path = path + ".z";
+  try {
+    if (argc > 2) {
+      generate(path, std::strtoul(argv[2], nullptr, 10));
+    }
+    const bulk_reader plain(path);
+    const auto compressed_size = plain.write(compressed_path, true);
+    if (!same_rows(plain, bulk_reader(compressed_path))) {
+      spdlog::error("{} doesn't read back the rows of {}", compressed_path,
+                    path);
+      return EXIT_FAILURE;
+    }
+
+    constexpr double BYTES_PER_MB = 1e6;
+    constexpr double MS_PER_S = 1e3;
+    const auto rows = static_cast<double>(plain.row_count());
+    const auto plain_size = static_cast<double>(plain.file_size());
+    std::cout << "rows: " << plain.row_count() << "\n";
+    std::cout << "size: " << plain.file_size() << " -> " << compressed_size
+              << " bytes, ratio "
+              << plain_size / static_cast<double>(compressed_size) << "\n";
+    for (const auto &file : {path, compressed_path}) {
+      const auto timing = measure(file);
+      std::cout << file << ": load " << timing.load_ms << " ms ("
+                << plain_size / BYTES_PER_MB / (timing.load_ms / MS_PER_S)
+                << " MB/s of rows), scan "
+                << rows / (timing.scan_ms / MS_PER_S) << " rows/s\n";
+    }
+  } catch (const std::exception &e) {
+    spdlog::error("Benchmark failed: {}", e.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
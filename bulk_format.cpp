@@ -0,0 +1,591 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "bulk_format.hpp"
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'S', 'Q', 'L', 'B', 'U', 'L', 'K', '1'};
+constexpr std::array<char, 8> COMPRESSED_MAGIC{'S', 'Q', 'L', 'B',
+                                               'U', 'L', 'K', '2'};
+
+// Rows per compressed block. Small enough that a block's decoded values
+// stay in cache while they are spread into the rows.
+constexpr uint32_t BLOCK_ROWS = 4096;
+
+// A column block is dictionary encoded while it has at most one distinct
+// string per this many rows
+constexpr std::size_t DICTIONARY_RATIO = 2;
+
+enum class codec_t : uint8_t {
+  PLAIN,
+  FRAME_OF_REFERENCE,
+  DICTIONARY,
+  RUN_LENGTH
+};
+
+auto field_width(const DB_ENGINE::Type &type) -> std::size_t {
+  switch (type.type) {
+  case DB_ENGINE::Type::INT:
+    return sizeof(int32_t);
+  case DB_ENGINE::Type::FLOAT:
+    return sizeof(double);
+  case DB_ENGINE::Type::BOOL:
+    return sizeof(uint8_t);
+  case DB_ENGINE::Type::VARCHAR:
+    return 2 * sizeof(uint32_t);
+  }
+  throw std::runtime_error("Unknown column type in bulk file");
+}
+
+template <typename T> auto load(const char *bytes) -> T {
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+template <typename T> void store(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+[[noreturn]] void corrupt(const std::string &path, std::string_view what) {
+  spdlog::error("Corrupt bulk file {}: {}", path, what);
+  throw std::runtime_error("Corrupt bulk file");
+}
+
+// Bounds checked reads from a file or a block's payload
+class byte_cursor {
+public:
+  byte_cursor(std::string_view bytes, const std::string &path)
+      : m_bytes(bytes), m_path(path) {}
+
+  auto take(std::size_t count) -> const char * {
+    if (m_bytes.size() - m_pos < count) {
+      corrupt(m_path, "truncated");
+    }
+    const char *bytes = m_bytes.data() + m_pos;
+    m_pos += count;
+    return bytes;
+  }
+
+  template <typename T> auto next() -> T { return load<T>(take(sizeof(T))); }
+
+  [[nodiscard]] auto pos() const -> std::size_t { return m_pos; }
+  [[nodiscard]] auto left() const -> std::size_t {
+    return m_bytes.size() - m_pos;
+  }
+
+private:
+  std::string_view m_bytes;
+  const std::string &m_path;
+  std::size_t m_pos = 0;
+};
+
+auto packed_size(std::size_t count, unsigned bits) -> std::size_t {
+  return (count * bits + 63) / 64 * sizeof(uint64_t);
+}
+
+// Appends the values bits wide, lowest bit first, in little endian words
+void pack_bits(std::span<const uint32_t> values, unsigned bits,
+               std::string &out) {
+  std::vector<uint64_t> words(packed_size(values.size(), bits) /
+                              sizeof(uint64_t));
+  std::size_t pos = 0;
+  for (const uint64_t value : values) {
+    const std::size_t word = pos / 64;
+    const std::size_t shift = pos % 64;
+    words[word] |= value << shift;
+    if (shift + bits > 64) {
+      words[word + 1] |= value >> (64 - shift);
+    }
+    pos += bits;
+  }
+  out.append(reinterpret_cast<const char *>(words.data()),
+             words.size() * sizeof(uint64_t));
+}
+
+void unpack_bits(const char *packed, unsigned bits, std::span<uint32_t> out) {
+  if (bits == 0) {
+    std::ranges::fill(out, 0);
+    return;
+  }
+  const uint64_t mask = (uint64_t{1} << bits) - 1;
+  std::size_t pos = 0;
+  for (auto &value : out) {
+    const char *word = packed + pos / 64 * sizeof(uint64_t);
+    const std::size_t shift = pos % 64;
+    uint64_t bits_at = load<uint64_t>(word) >> shift;
+    if (shift + bits > 64) {
+      bits_at |= load<uint64_t>(word + sizeof(uint64_t)) << (64 - shift);
+    }
+    value = static_cast<uint32_t>(bits_at & mask);
+    pos += bits;
+  }
+}
+
+// Adds the frame's minimum back, wrapping like the i32 it was taken from
+void add_reference(std::span<uint32_t> values, uint32_t reference) {
+  std::size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i splat = _mm256_set1_epi32(static_cast<int>(reference));
+  for (; i + 8 <= values.size(); i += 8) {
+    auto *p = reinterpret_cast<__m256i *>(values.data() + i);
+    _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), splat));
+  }
+#elif defined(__SSE2__)
+  const __m128i splat = _mm_set1_epi32(static_cast<int>(reference));
+  for (; i + 4 <= values.size(); i += 4) {
+    auto *p = reinterpret_cast<__m128i *>(values.data() + i);
+    _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), splat));
+  }
+#endif
+  for (; i < values.size(); ++i) {
+    values[i] += reference;
+  }
+}
+
+} // namespace
+
+auto bulk_reader::is_bulk_file(const std::string &path) -> bool {
+  std::ifstream in(path, std::ios::binary);
+  std::array<char, MAGIC.size()> magic{};
+  in.read(magic.data(), magic.size());
+  return in.good() && (magic == MAGIC || magic == COMPRESSED_MAGIC);
+}
+
+bulk_reader::bulk_reader(const std::string &path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in.good()) {
+    spdlog::error("Failed to open {}", path);
+    throw std::runtime_error("Failed to open bulk file");
+  }
+  m_data.resize(static_cast<std::size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(m_data.data(), static_cast<std::streamsize>(m_data.size()));
+  m_file_size = m_data.size();
+
+  byte_cursor file({m_data.data(), m_data.size()}, path);
+  const char *magic = file.take(MAGIC.size());
+  m_compressed = std::memcmp(magic, COMPRESSED_MAGIC.data(),
+                             COMPRESSED_MAGIC.size()) == 0;
+  if (!m_compressed && std::memcmp(magic, MAGIC.data(), MAGIC.size()) != 0) {
+    corrupt(path, "bad magic");
+  }
+  const auto column_count = file.next<uint32_t>();
+  for (uint32_t i = 0; i < column_count; ++i) {
+    const auto type = file.next<uint8_t>();
+    const auto size = file.next<uint8_t>();
+    const auto name_length = file.next<uint16_t>();
+    const char *name = file.take(name_length);
+    if (type > DB_ENGINE::Type::VARCHAR) {
+      corrupt(path, "unknown column type");
+    }
+    m_columns.push_back(
+        {std::string(name, name_length),
+         DB_ENGINE::Type(static_cast<DB_ENGINE::Type::types>(type), size)});
+    m_offsets.push_back(m_row_width);
+    m_row_width += field_width(m_columns.back().type);
+  }
+
+  m_rows = file.next<uint64_t>();
+  if (m_compressed) {
+    decompress(path, file.pos());
+    return;
+  }
+  if (m_row_width != 0 && m_rows > file.left() / m_row_width) {
+    corrupt(path, "truncated rows");
+  }
+  m_rows_start = file.pos();
+  file.take(m_rows * m_row_width);
+  m_heap_size = file.next<uint64_t>();
+  m_heap_start = file.pos();
+  file.take(m_heap_size);
+
+  // Checked once here so reading rows never has to
+  for (std::size_t column = 0; column < m_columns.size(); ++column) {
+    if (m_columns[column].type.type != DB_ENGINE::Type::VARCHAR) {
+      continue;
+    }
+    for (std::size_t row = 0; row < m_rows; ++row) {
+      const char *bytes = field(row, column);
+      const uint64_t offset = load<uint32_t>(bytes);
+      const uint64_t length = load<uint32_t>(bytes + sizeof(uint32_t));
+      if (offset + length > m_heap_size) {
+        corrupt(path, "string outside the heap");
+      }
+    }
+  }
+}
+
+// Decodes the blocks one at a time into the same rows and heap an
+// uncompressed file has, so reading rows doesn't care which it was. The
+// file's bytes are released once decoded.
+void bulk_reader::decompress(const std::string &path, std::size_t pos) {
+  const std::vector<char> data = std::move(m_data);
+  byte_cursor file({data.data() + pos, data.size() - pos}, path);
+  const auto block_rows = file.next<uint32_t>();
+  if (m_rows != 0 && (block_rows == 0 || m_row_width == 0)) {
+    corrupt(path, "empty blocks");
+  }
+  // Each column of a block takes at least its codec and size
+  constexpr std::size_t BLOCK_HEADER = sizeof(uint8_t) + sizeof(uint32_t);
+  if (m_rows != 0 && (m_rows - 1) / block_rows + 1 >
+                         file.left() / (BLOCK_HEADER * m_columns.size())) {
+    corrupt(path, "truncated rows");
+  }
+
+  std::vector<char> rows(m_rows * m_row_width);
+  std::string heap;
+  std::vector<uint32_t> values(std::min<std::size_t>(block_rows, m_rows));
+  // Heap offset and length, the field a VARCHAR row holds
+  using string_field_t = std::array<uint32_t, 2>;
+  std::vector<string_field_t> entries;
+  for (std::size_t first = 0; first < m_rows; first += block_rows) {
+    const std::size_t count = std::min<std::size_t>(block_rows, m_rows - first);
+    const auto block = std::span(values).first(count);
+    for (std::size_t column = 0; column < m_columns.size(); ++column) {
+      const auto codec = static_cast<codec_t>(file.next<uint8_t>());
+      const auto size = file.next<uint32_t>();
+      byte_cursor payload({file.take(size), size}, path);
+      char *out = rows.data() + first * m_row_width + m_offsets[column];
+      auto put = [&](std::size_t row, auto value) {
+        std::memcpy(out + row * m_row_width, &value, sizeof(value));
+      };
+      auto unpack = [&](uint32_t limit) {
+        const auto bits = payload.next<uint8_t>();
+        if (bits > 32) {
+          corrupt(path, "bit width over 32");
+        }
+        unpack_bits(payload.take(packed_size(count, bits)), bits, block);
+        if (limit != 0 && std::ranges::any_of(block, [&](uint32_t code) {
+              return code >= limit;
+            })) {
+          corrupt(path, "code outside the dictionary");
+        }
+      };
+
+      switch (m_columns[column].type.type) {
+      case DB_ENGINE::Type::INT:
+        if (codec == codec_t::FRAME_OF_REFERENCE) {
+          const auto reference = payload.next<uint32_t>();
+          unpack(0);
+          add_reference(block, reference);
+          for (std::size_t row = 0; row < count; ++row) {
+            put(row, block[row]);
+          }
+          break;
+        }
+        if (codec != codec_t::PLAIN) {
+          corrupt(path, "bad INT codec");
+        }
+        for (std::size_t row = 0; row < count; ++row) {
+          put(row, payload.next<int32_t>());
+        }
+        break;
+      case DB_ENGINE::Type::FLOAT:
+        if (codec != codec_t::PLAIN) {
+          corrupt(path, "bad FLOAT codec");
+        }
+        for (std::size_t row = 0; row < count; ++row) {
+          put(row, payload.next<double>());
+        }
+        break;
+      case DB_ENGINE::Type::BOOL:
+        if (codec == codec_t::RUN_LENGTH) {
+          const auto runs = payload.next<uint32_t>();
+          std::size_t row = 0;
+          for (uint32_t run = 0; run < runs; ++run) {
+            const auto value = payload.next<uint8_t>();
+            const auto length = payload.next<uint32_t>();
+            if (length > count - row) {
+              corrupt(path, "run past the block");
+            }
+            for (const auto end = row + length; row < end; ++row) {
+              put(row, value);
+            }
+          }
+          if (row != count) {
+            corrupt(path, "runs short of the block");
+          }
+          break;
+        }
+        if (codec != codec_t::PLAIN) {
+          corrupt(path, "bad BOOL codec");
+        }
+        for (std::size_t row = 0; row < count; ++row) {
+          put(row, payload.next<uint8_t>());
+        }
+        break;
+      case DB_ENGINE::Type::VARCHAR: {
+        // Offsets into the heap are u32
+        auto append = [&](std::size_t length) {
+          const auto offset = heap.size();
+          if (offset + length > std::numeric_limits<uint32_t>::max()) {
+            corrupt(path, "heap over 4 GiB");
+          }
+          heap.append(payload.take(length), length);
+          return static_cast<uint32_t>(offset);
+        };
+        if (codec == codec_t::DICTIONARY) {
+          const auto size = payload.next<uint32_t>();
+          entries.clear();
+          for (uint32_t entry = 0; entry < size; ++entry) {
+            const auto length = payload.next<uint32_t>();
+            entries.push_back({append(length), length});
+          }
+          unpack(size);
+          for (std::size_t row = 0; row < count; ++row) {
+            put(row, entries[block[row]]);
+          }
+          break;
+        }
+        if (codec != codec_t::PLAIN) {
+          corrupt(path, "bad VARCHAR codec");
+        }
+        byte_cursor lengths({payload.take(count * sizeof(uint32_t)),
+                             count * sizeof(uint32_t)},
+                            path);
+        for (std::size_t row = 0; row < count; ++row) {
+          const auto length = lengths.next<uint32_t>();
+          put(row, string_field_t{append(length), length});
+        }
+        break;
+      }
+      }
+      if (payload.left() != 0) {
+        corrupt(path, "block longer than its values");
+      }
+    }
+  }
+
+  // Moved rather than appended to the rows, so the decoded file is never
+  // held twice
+  m_rows_start = 0;
+  m_heap_start = 0;
+  m_heap_size = heap.size();
+  m_data = std::move(rows);
+  m_decoded_heap = std::move(heap);
+}
+
+auto bulk_reader::heap() const -> const char * {
+  return m_compressed ? m_decoded_heap.data() : m_data.data() + m_heap_start;
+}
+
+auto bulk_reader::field(std::size_t row, std::size_t column) const
+    -> const char * {
+  return m_data.data() + m_rows_start + row * m_row_width + m_offsets[column];
+}
+
+auto bulk_reader::string_at(const char *field) const -> std::string_view {
+  return {heap() + load<uint32_t>(field),
+          load<uint32_t>(field + sizeof(uint32_t))};
+}
+
+void bulk_reader::row_values(std::size_t row,
+                             std::vector<std::string> &values) const {
+  values.resize(m_columns.size());
+  for (std::size_t column = 0; column < m_columns.size(); ++column) {
+    const char *bytes = field(row, column);
+    auto &value = values[column];
+    switch (m_columns[column].type.type) {
+    case DB_ENGINE::Type::INT:
+      value = std::to_string(load<int32_t>(bytes));
+      break;
+    case DB_ENGINE::Type::FLOAT:
+      value = std::to_string(load<double>(bytes));
+      break;
+    case DB_ENGINE::Type::BOOL:
+      value = std::to_string(static_cast<int>(load<uint8_t>(bytes) != 0));
+      break;
+    case DB_ENGINE::Type::VARCHAR: {
+      const auto text = string_at(bytes);
+      value.assign(1, '\'');
+      value.append(text);
+      value += '\'';
+      break;
+    }
+    }
+  }
+}
+
+auto bulk_reader::less(std::size_t column, std::size_t a, std::size_t b) const
+    -> bool {
+  const char *left = field(a, column);
+  const char *right = field(b, column);
+  switch (m_columns[column].type.type) {
+  case DB_ENGINE::Type::INT:
+    return load<int32_t>(left) < load<int32_t>(right);
+  case DB_ENGINE::Type::FLOAT:
+    return load<double>(left) < load<double>(right);
+  case DB_ENGINE::Type::BOOL:
+    return load<uint8_t>(left) < load<uint8_t>(right);
+  case DB_ENGINE::Type::VARCHAR:
+    return string_at(left) < string_at(right);
+  }
+  return false;
+}
+
+
+auto bulk_reader::encode_column(std::size_t column, std::size_t first,
+                                std::size_t count, std::string &payload) const
+    -> uint8_t {
+  std::vector<uint32_t> values;
+  std::unordered_map<std::string_view, uint32_t> dictionary;
+  std::vector<std::string_view> entries;
+  auto at = [&](std::size_t row) { return field(first + row, column); };
+  auto codec = codec_t::PLAIN;
+  switch (m_columns[column].type.type) {
+  case DB_ENGINE::Type::INT: {
+    int32_t min = std::numeric_limits<int32_t>::max();
+    int32_t max = std::numeric_limits<int32_t>::min();
+    for (std::size_t row = 0; row < count; ++row) {
+      const auto value = load<int32_t>(at(row));
+      min = std::min(min, value);
+      max = std::max(max, value);
+    }
+    const auto range =
+        static_cast<uint32_t>(max) - static_cast<uint32_t>(min);
+    const auto bits = static_cast<unsigned>(std::bit_width(range));
+    if (bits >= 32) {
+      for (std::size_t row = 0; row < count; ++row) {
+        store(payload, load<int32_t>(at(row)));
+      }
+      break;
+    }
+    codec = codec_t::FRAME_OF_REFERENCE;
+    for (std::size_t row = 0; row < count; ++row) {
+      values.push_back(static_cast<uint32_t>(load<int32_t>(at(row))) -
+                       static_cast<uint32_t>(min));
+    }
+    store(payload, min);
+    store(payload, static_cast<uint8_t>(bits));
+    pack_bits(values, bits, payload);
+    break;
+  }
+  case DB_ENGINE::Type::FLOAT:
+    for (std::size_t row = 0; row < count; ++row) {
+      store(payload, load<double>(at(row)));
+    }
+    break;
+  case DB_ENGINE::Type::BOOL: {
+    // Runs of at most count rows, which fits the u32 length
+    std::vector<std::pair<uint8_t, uint32_t>> runs;
+    for (std::size_t row = 0; row < count; ++row) {
+      const uint8_t value = load<uint8_t>(at(row)) != 0 ? 1 : 0;
+      if (runs.empty() || runs.back().first != value) {
+        runs.emplace_back(value, 0);
+      }
+      ++runs.back().second;
+    }
+    constexpr std::size_t RUN_BYTES = sizeof(uint8_t) + sizeof(uint32_t);
+    if (runs.size() * RUN_BYTES >= count) {
+      for (std::size_t row = 0; row < count; ++row) {
+        store(payload, load<uint8_t>(at(row)));
+      }
+      break;
+    }
+    codec = codec_t::RUN_LENGTH;
+    store(payload, static_cast<uint32_t>(runs.size()));
+    for (const auto &[value, length] : runs) {
+      store(payload, value);
+      store(payload, length);
+    }
+    break;
+  }
+  case DB_ENGINE::Type::VARCHAR: {
+    for (std::size_t row = 0; row < count; ++row) {
+      const auto text = string_at(at(row));
+      const auto [it, added] = dictionary.try_emplace(
+          text, static_cast<uint32_t>(entries.size()));
+      if (added) {
+        if (DICTIONARY_RATIO * (entries.size() + 1) > count) {
+          break;
+        }
+        entries.push_back(text);
+      }
+      values.push_back(it->second);
+    }
+    if (values.size() == count) {
+      codec = codec_t::DICTIONARY;
+      store(payload, static_cast<uint32_t>(entries.size()));
+      for (const auto text : entries) {
+        store(payload, static_cast<uint32_t>(text.size()));
+        payload += text;
+      }
+      const auto bits =
+          static_cast<unsigned>(std::bit_width(entries.size() - 1));
+      store(payload, static_cast<uint8_t>(bits));
+      pack_bits(values, bits, payload);
+      break;
+    }
+    for (std::size_t row = 0; row < count; ++row) {
+      store(payload, static_cast<uint32_t>(string_at(at(row)).size()));
+    }
+    for (std::size_t row = 0; row < count; ++row) {
+      payload += string_at(at(row));
+    }
+    break;
+  }
+  }
+  return static_cast<uint8_t>(codec);
+}
+
+auto bulk_reader::write(const std::string &path, bool compress) const
+    -> std::size_t {
+  std::string out;
+  const auto &magic = compress ? COMPRESSED_MAGIC : MAGIC;
+  out.append(magic.data(), magic.size());
+  store(out, static_cast<uint32_t>(m_columns.size()));
+  for (const auto &column : m_columns) {
+    store(out, static_cast<uint8_t>(column.type.type));
+    store(out, static_cast<uint8_t>(column.type.size));
+    store(out, static_cast<uint16_t>(column.name.size()));
+    out += column.name;
+  }
+  store(out, static_cast<uint64_t>(m_rows));
+
+  if (!compress) {
+    out.append(m_data.data() + m_rows_start, m_rows * m_row_width);
+    store(out, static_cast<uint64_t>(m_heap_size));
+    out.append(heap(), m_heap_size);
+  } else {
+    store(out, BLOCK_ROWS);
+    std::string payload;
+    for (std::size_t first = 0; first < m_rows; first += BLOCK_ROWS) {
+      const std::size_t count =
+          std::min<std::size_t>(BLOCK_ROWS, m_rows - first);
+      for (std::size_t column = 0; column < m_columns.size(); ++column) {
+        payload.clear();
+        const auto codec = encode_column(column, first, count, payload);
+        if (payload.size() > std::numeric_limits<uint32_t>::max()) {
+          spdlog::error("Block of column {} is over 4 GiB",
+                        m_columns[column].name);
+          throw std::runtime_error("Bulk file block too large");
+        }
+        store(out, codec);
+        store(out, static_cast<uint32_t>(payload.size()));
+        out += payload;
+      }
+    }
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(out.data(), static_cast<std::streamsize>(out.size()));
+  if (!file.good()) {
+    spdlog::error("Failed to write {}", path);
+    throw std::runtime_error("Failed to write bulk file");
+  }
+  return out.size();
+}
@@ -0,0 +1,89 @@
+#ifndef BULK_FORMAT_HPP
+#define BULK_FORMAT_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DBEngine.hpp"
+
+// Typed rows for INSERT INTO t FROM 'file.bin', all little endian:
+//   "SQLBULK1"
+//   u32 column count, per column: u8 Type::types, u8 size, u16 name length,
+//     name bytes
+//   u64 row count, then the fixed-width rows. Per column INT is an i32,
+//     FLOAT an f64, BOOL a u8 and VARCHAR a u32 offset and u32 length into
+//     the string heap.
+//   u64 heap size, heap bytes
+//
+// "SQLBULK2" files have the same columns, then u64 row count, u32 rows per
+// block and the blocks. Each block holds every column in turn as a u8
+// codec, a u32 payload size and the payload:
+//   PLAIN               the values packed together. VARCHAR has a u32
+//                       length per row, then the bytes.
+//   FRAME_OF_REFERENCE  INT as an i32 minimum, u8 bit width and the
+//                       bit-packed differences from the minimum
+//   DICTIONARY          VARCHAR as u32 entry count, each entry's u32 length
+//                       and bytes, u8 bit width and bit-packed codes
+//   RUN_LENGTH          BOOL as u32 run count, each run a u8 value and u32
+//                       length
+class bulk_reader {
+public:
+  struct column_t {
+    std::string name;
+    DB_ENGINE::Type type;
+  };
+
+  // Reads and validates the whole file, throws on anything malformed
+  explicit bulk_reader(const std::string &path);
+
+  static auto is_bulk_file(const std::string &path) -> bool;
+
+  [[nodiscard]] auto columns() const -> const std::vector<column_t> & {
+    return m_columns;
+  }
+  [[nodiscard]] auto row_count() const -> std::size_t { return m_rows; }
+  [[nodiscard]] auto file_size() const -> std::size_t { return m_file_size; }
+  [[nodiscard]] auto compressed() const -> bool { return m_compressed; }
+
+  // The row's values spelled the way INSERT ... VALUES hands them to the
+  // engine: numbers through std::to_string and strings quoted
+  void row_values(std::size_t row, std::vector<std::string> &values) const;
+
+  [[nodiscard]] auto less(std::size_t column, std::size_t a,
+                          std::size_t b) const -> bool;
+
+  // Writes the rows as a "SQLBULK2" file when compress is set, otherwise as
+  // "SQLBULK1". Returns the bytes written.
+  auto write(const std::string &path, bool compress) const -> std::size_t;
+
+private:
+  void decompress(const std::string &path, std::size_t pos);
+
+  // Appends the column's values in rows [first, first + count) with the
+  // cheapest codec that fits them, returns the codec
+  auto encode_column(std::size_t column, std::size_t first, std::size_t count,
+                     std::string &payload) const -> uint8_t;
+
+  [[nodiscard]] auto field(std::size_t row, std::size_t column) const
+      -> const char *;
+  [[nodiscard]] auto string_at(const char *field) const -> std::string_view;
+  [[nodiscard]] auto heap() const -> const char *;
+
+  // The whole file, or for a compressed one the decoded rows
+  std::vector<char> m_data;
+  std::string m_decoded_heap; // Only for a compressed file
+  std::size_t m_file_size = 0;
+  bool m_compressed = false;
+  std::vector<column_t> m_columns;
+  std::vector<std::size_t> m_offsets; // Of each column within a row
+  std::size_t m_row_width = 0;
+  std::size_t m_rows = 0;
+  std::size_t m_rows_start = 0;
+  std::size_t m_heap_start = 0;
+  std::size_t m_heap_size = 0;
+};
+
+#endif // BULK_FORMAT_HPP
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
+#include "columnar.hpp"
+
+namespace {
+
+auto unquoted(std::string_view value) -> std::string_view {
+  if (value.size() >= 2 && value.front() == '\'' && value.back() == '\'') {
+    return value.substr(1, value.size() - 2);
+  }
+  return value;
+}
+
+template <typename T> auto parse(std::string_view text, T &value) -> bool {
+  const char *end = text.data() + text.size();
+  const auto result = std::from_chars(text.data(), end, value);
+  return result.ec == std::errc{} && result.ptr == end;
+}
+
+auto parse_bool(std::string_view text, bool &value) -> bool {
+  text = unquoted(text);
+  auto is = [&](std::string_view word) {
+    return std::ranges::equal(text, word, [](char a, char b) {
+      return (a | 0x20) == b;
+    });
+  };
+  if (text == "1" || is("true")) {
+    value = true;
+    return true;
+  }
+  if (text == "0" || is("false")) {
+    value = false;
+    return true;
+  }
+  return false;
+}
+
+auto infer_type(std::span<const DB_ENGINE::Record> records,
+                std::size_t column) -> column_type_t {
+  bool all_int = true;
+  bool all_double = true;
+  for (const auto &record : records) {
+    const std::string_view text = record.m_fields[column];
+    if (text.empty()) {
+      continue;
+    }
+    int32_t int_value = 0;
+    double double_value = 0;
+    all_int = all_int && parse(text, int_value);
+    all_double = all_double && parse(text, double_value);
+    if (!all_double) {
+      return column_type_t::UTF8;
+    }
+  }
+  return all_int ? column_type_t::INT32 : column_type_t::FLOAT64;
+}
+
+void set_bit(arrow_buffer &bits, std::size_t index) {
+  bits.data()[index / 8] |= std::byte{1} << (index % 8);
+}
+
+// Rows per distinct value a column needs before it is worth encoding
+constexpr std::size_t DICTIONARY_RATIO = 2;
+
+// Fills codes and the dictionary, false once there are too many distinct
+// values to gain anything
+auto encode_utf8(std::span<const DB_ENGINE::Record> records,
+                 std::size_t column, result_column_t &out) -> bool {
+  const std::size_t length = records.size();
+  const std::size_t max_entries = length / DICTIONARY_RATIO;
+  std::unordered_map<std::string_view, int32_t> codes;
+  std::vector<std::string_view> entries;
+
+  out.values.resize(length * sizeof(int32_t));
+  auto *row_codes = reinterpret_cast<int32_t *>(out.values.data());
+  for (std::size_t row = 0; row < length; ++row) {
+    const auto text = unquoted(records[row].m_fields[column]);
+    const auto [it, inserted] =
+        codes.try_emplace(text, static_cast<int32_t>(entries.size()));
+    if (inserted) {
+      if (entries.size() == max_entries) {
+        out.values.clear();
+        return false;
+      }
+      entries.push_back(text);
+    }
+    row_codes[row] = it->second;
+  }
+
+  out.dictionary_offsets.resize((entries.size() + 1) * sizeof(int32_t));
+  auto *offsets = reinterpret_cast<int32_t *>(out.dictionary_offsets.data());
+  offsets[0] = 0;
+  for (std::size_t code = 0; code < entries.size(); ++code) {
+    out.dictionary_values.append(entries[code].data(), entries[code].size());
+    offsets[code + 1] = static_cast<int32_t>(out.dictionary_values.size());
+  }
+  out.encoded = true;
+  return true;
+}
+
+void build_column(std::span<const DB_ENGINE::Record> records,
+                  std::size_t column, bool encode_strings,
+                  result_column_t &out) {
+  const std::size_t length = records.size();
+  out.null_count = 0;
+  out.validity.clear();
+  out.offsets.clear();
+  out.values.clear();
+  out.encoded = false;
+  out.dictionary_offsets.clear();
+  out.dictionary_values.clear();
+
+  // Filled lazily, the first null sets every earlier row valid
+  auto set_null = [&](std::size_t row) {
+    if (out.validity.size() == 0) {
+      out.validity.resize((length + 7) / 8);
+      for (std::size_t i = 0; i < row; ++i) {
+        set_bit(out.validity, i);
+      }
+    }
+    ++out.null_count;
+  };
+  auto set_valid = [&](std::size_t row) {
+    if (out.validity.size() != 0) {
+      set_bit(out.validity, row);
+    }
+  };
+
+  switch (out.type) {
+  case column_type_t::INT32:
+  case column_type_t::FLOAT64: {
+    const bool is_int = out.type == column_type_t::INT32;
+    out.values.resize(length * (is_int ? sizeof(int32_t) : sizeof(double)));
+    auto *ints = reinterpret_cast<int32_t *>(out.values.data());
+    auto *doubles = reinterpret_cast<double *>(out.values.data());
+    for (std::size_t row = 0; row < length; ++row) {
+      const std::string_view text = records[row].m_fields[column];
+      const bool valid = is_int ? parse(text, ints[row])
+                                : parse(text, doubles[row]);
+      if (valid) {
+        set_valid(row);
+      } else {
+        set_null(row);
+      }
+    }
+    break;
+  }
+  case column_type_t::BOOL:
+    out.values.resize((length + 7) / 8);
+    for (std::size_t row = 0; row < length; ++row) {
+      bool value = false;
+      if (!parse_bool(records[row].m_fields[column], value)) {
+        set_null(row);
+        continue;
+      }
+      set_valid(row);
+      if (value) {
+        set_bit(out.values, row);
+      }
+    }
+    break;
+  case column_type_t::UTF8: {
+    if (encode_strings && encode_utf8(records, column, out)) {
+      break;
+    }
+    out.offsets.resize((length + 1) * sizeof(int32_t));
+    auto *offsets = reinterpret_cast<int32_t *>(out.offsets.data());
+    offsets[0] = 0;
+    for (std::size_t row = 0; row < length; ++row) {
+      const auto text = unquoted(records[row].m_fields[column]);
+      out.values.append(text.data(), text.size());
+      offsets[row + 1] = static_cast<int32_t>(out.values.size());
+    }
+    break;
+  }
+  }
+}
+
+} // namespace
+
+arrow_buffer::~arrow_buffer() {
+  ::operator delete(m_data, std::align_val_t{ALIGNMENT});
+}
+
+arrow_buffer::arrow_buffer(arrow_buffer &&other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_capacity(std::exchange(other.m_capacity, 0)) {}
+
+auto arrow_buffer::operator=(arrow_buffer &&other) noexcept
+    -> arrow_buffer & {
+  std::swap(m_data, other.m_data);
+  std::swap(m_size, other.m_size);
+  std::swap(m_capacity, other.m_capacity);
+  return *this;
+}
+
+void arrow_buffer::reserve(std::size_t capacity) {
+  if (capacity <= m_capacity) {
+    return;
+  }
+  capacity = std::max((capacity + ALIGNMENT - 1) & ~(ALIGNMENT - 1),
+                      2 * m_capacity);
+  auto *data = static_cast<std::byte *>(
+      ::operator new(capacity, std::align_val_t{ALIGNMENT}));
+  if (m_size != 0) {
+    std::memcpy(data, m_data, m_size);
+  }
+  ::operator delete(m_data, std::align_val_t{ALIGNMENT});
+  m_data = data;
+  m_capacity = capacity;
+}
+
+void arrow_buffer::resize(std::size_t size) {
+  reserve(size);
+  const std::size_t padded = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  if (padded > m_size) {
+    std::memset(m_data + m_size, 0, padded - m_size);
+  }
+  m_size = size;
+}
+
+void arrow_buffer::append(const void *bytes, std::size_t count) {
+  const std::size_t size = m_size;
+  reserve(size + count);
+  if (count != 0) {
+    std::memcpy(m_data + size, bytes, count);
+  }
+  m_size = size + count;
+  std::memset(m_data + m_size, 0, padded_size() - m_size);
+}
+
+auto result_column_t::dictionary(std::size_t code) const
+    -> std::string_view {
+  const auto offsets = dictionary_offsets.as<int32_t>();
+  return {reinterpret_cast<const char *>(dictionary_values.data()) +
+              offsets[code],
+          static_cast<std::size_t>(offsets[code + 1] - offsets[code])};
+}
+
+auto result_column_t::utf8(std::size_t row) const -> std::string_view {
+  if (encoded) {
+    return dictionary(static_cast<std::size_t>(codes()[row]));
+  }
+  const auto offsets = this->offsets.as<int32_t>();
+  return {reinterpret_cast<const char *>(values.data()) + offsets[row],
+          static_cast<std::size_t>(offsets[row + 1] - offsets[row])};
+}
+
+void infer_column_types(std::span<const DB_ENGINE::Record> records,
+                        std::vector<std::optional<column_type_t>> &types) {
+  for (std::size_t column = 0; column < types.size(); ++column) {
+    if (!types[column]) {
+      types[column] = infer_type(records, column);
+    }
+  }
+}
+
+void to_columnar(std::span<const DB_ENGINE::Record> records,
+                 const std::vector<std::string> &names,
+                 std::vector<std::optional<column_type_t>> types,
+                 columnar_result_t &out, bool encode_strings) {
+  types.resize(names.size());
+  infer_column_types(records, types);
+
+  out.length = records.size();
+  out.columns.resize(names.size());
+  for (std::size_t column = 0; column < names.size(); ++column) {
+    auto &result = out.columns[column];
+    result.name = names[column];
+    result.type = *types[column];
+    build_column(records, column, encode_strings, result);
+  }
+}
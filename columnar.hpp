@@ -0,0 +1,123 @@
+#ifndef COLUMNAR_HPP
+#define COLUMNAR_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Record/Record.hpp"
+
+// Growable buffer with Arrow's recommended layout: 64-byte aligned and zero
+// padded to a multiple of 64 bytes. clear() keeps the allocation.
+class arrow_buffer {
+public:
+  static constexpr std::size_t ALIGNMENT = 64;
+
+  arrow_buffer() = default;
+  ~arrow_buffer();
+  arrow_buffer(arrow_buffer &&other) noexcept;
+  auto operator=(arrow_buffer &&other) noexcept -> arrow_buffer &;
+  arrow_buffer(const arrow_buffer &) = delete;
+  auto operator=(const arrow_buffer &) -> arrow_buffer & = delete;
+
+  [[nodiscard]] auto data() const -> const std::byte * { return m_data; }
+  [[nodiscard]] auto data() -> std::byte * { return m_data; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+  [[nodiscard]] auto padded_size() const -> std::size_t {
+    return (m_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  }
+
+  void clear() { m_size = 0; }
+  void resize(std::size_t size); // New bytes are zero
+  void append(const void *bytes, std::size_t count);
+
+  template <typename T> void push_back(const T &value) {
+    append(&value, sizeof(T));
+  }
+
+  template <typename T> [[nodiscard]] auto as() const -> std::span<const T> {
+    return {reinterpret_cast<const T *>(m_data), m_size / sizeof(T)};
+  }
+
+private:
+  void reserve(std::size_t capacity);
+
+  std::byte *m_data = nullptr;
+  std::size_t m_size = 0;
+  std::size_t m_capacity = 0;
+};
+
+// Arrow types a result column can take, VARCHAR maps to utf8
+enum class column_type_t { INT32, FLOAT64, BOOL, UTF8 };
+
+// One column in Arrow's memory format. validity is empty when there are no
+// nulls, as Arrow allows; bools are bit-packed like the validity bitmap.
+// A dictionary encoded UTF8 column holds an int32 code per row in values
+// and the distinct strings, in code order, in the dictionary buffers.
+struct result_column_t {
+  std::string name;
+  column_type_t type = column_type_t::UTF8;
+  std::size_t null_count = 0;
+  arrow_buffer validity; // Bit per row, least significant bit first
+  arrow_buffer offsets;  // length + 1 int32 offsets into values, UTF8 only
+  arrow_buffer values;
+  bool encoded = false;
+  arrow_buffer dictionary_offsets;
+  arrow_buffer dictionary_values;
+
+  [[nodiscard]] auto is_valid(std::size_t row) const -> bool {
+    return validity.size() == 0 ||
+           ((static_cast<unsigned>(validity.data()[row / 8]) >> (row % 8)) &
+            1U) != 0;
+  }
+  [[nodiscard]] auto int32s() const -> std::span<const int32_t> {
+    return values.as<int32_t>();
+  }
+  [[nodiscard]] auto float64s() const -> std::span<const double> {
+    return values.as<double>();
+  }
+  [[nodiscard]] auto boolean(std::size_t row) const -> bool {
+    return ((static_cast<unsigned>(values.data()[row / 8]) >> (row % 8)) &
+            1U) != 0;
+  }
+  [[nodiscard]] auto codes() const -> std::span<const int32_t> {
+    return values.as<int32_t>();
+  }
+  [[nodiscard]] auto dictionary_size() const -> std::size_t {
+    return dictionary_offsets.size() / sizeof(int32_t) - 1;
+  }
+  [[nodiscard]] auto dictionary(std::size_t code) const -> std::string_view;
+  // Decodes through the dictionary when the column is encoded
+  [[nodiscard]] auto utf8(std::size_t row) const -> std::string_view;
+};
+
+// A result as a single record batch
+struct columnar_result_t {
+  std::size_t length = 0;
+  std::vector<result_column_t> columns;
+
+  void clear() {
+    length = 0;
+    columns.clear();
+  }
+};
+
+// Fills in the types that aren't known from the values: int32 if they all
+// fit, else float64 if they all parse, else utf8
+void infer_column_types(std::span<const DB_ENGINE::Record> records,
+                        std::vector<std::optional<column_type_t>> &types);
+
+// Transposes rows into columns, inferring the types that aren't given.
+// Values that don't parse as their column's type become nulls, quotes around
+// strings are dropped. With encode_strings, UTF8 columns with at most one
+// distinct value per two rows are dictionary encoded.
+void to_columnar(std::span<const DB_ENGINE::Record> records,
+                 const std::vector<std::string> &names,
+                 std::vector<std::optional<column_type_t>> types,
+                 columnar_result_t &out, bool encode_strings = false);
+
+#endif // COLUMNAR_HPP
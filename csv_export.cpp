@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string_view>
+
+#include "csv_export.hpp"
+#include "scheduler.hpp"
+
+namespace {
+
+constexpr std::size_t BLOCK_ROWS = 16 * 1024;
+constexpr std::size_t BLOCKS_PER_THREAD = 2; // In flight, bounds the memory
+constexpr std::size_t NO_BLOCK = std::numeric_limits<std::size_t>::max();
+constexpr std::chrono::milliseconds RECHECK{1};
+
+void append_text(std::string &out, std::string_view text) {
+  if (text.find_first_of(",\"\n\r") == std::string_view::npos) {
+    out.append(text);
+    return;
+  }
+  out += '"';
+  for (const char c : text) {
+    if (c == '"') {
+      out += '"';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+void append_value(std::string &out, std::string_view value) {
+  if (value.size() >= 2 && value.front() == '\'' && value.back() == '\'') {
+    append_text(out, value.substr(1, value.size() - 2));
+    return;
+  }
+
+  const char *end = value.data() + value.size();
+  int64_t integer = 0;
+  auto parsed = std::from_chars(value.data(), end, integer);
+  if (parsed.ec == std::errc{} && parsed.ptr == end) {
+    out.append(value);
+    return;
+  }
+  double number = 0;
+  parsed = std::from_chars(value.data(), end, number);
+  if (parsed.ec == std::errc{} && parsed.ptr == end) {
+    // Shortest form that reads back as the same double
+    std::array<char, 32> digits{};
+    const auto printed =
+        std::to_chars(digits.data(), digits.data() + digits.size(), number);
+    out.append(digits.data(), printed.ptr);
+    return;
+  }
+  append_text(out, value);
+}
+
+void format_rows(std::string &out,
+                 const std::vector<DB_ENGINE::Record> &records,
+                 std::size_t first, std::size_t last) {
+  out.clear();
+  for (std::size_t row = first; row < last; ++row) {
+    const auto &fields = records[row].m_fields;
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      if (i != 0) {
+        out += ',';
+      }
+      append_value(out, fields[i]);
+    }
+    out += '\n';
+  }
+}
+
+} // namespace
+
+auto write_csv(const std::string &path,
+               const std::vector<DB_ENGINE::Record> &records,
+               const std::vector<std::string> &names, std::size_t threads)
+    -> csv_export_stats_t {
+  const auto start = std::chrono::steady_clock::now();
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out.good()) {
+    spdlog::error("Failed to open {}", path);
+    throw std::runtime_error("Failed to open csv file");
+  }
+  csv_export_stats_t stats;
+  stats.rows = records.size();
+
+  std::string header;
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (i != 0) {
+      header += ',';
+    }
+    append_text(header, names[i]);
+  }
+  header += '\n';
+  out.write(header.data(), static_cast<std::streamsize>(header.size()));
+  stats.bytes += header.size();
+
+  const std::size_t blocks = (records.size() + BLOCK_ROWS - 1) / BLOCK_ROWS;
+  auto &scheduler = task_scheduler::instance();
+  if (threads == 0) {
+    threads = scheduler.workers();
+  }
+
+  // Block b is formatted into slot b % window. Block b + window is only
+  // submitted once b has been written, so tasks never wait for a slot.
+  const std::size_t window = std::max<std::size_t>(1, threads) *
+                             BLOCKS_PER_THREAD;
+  std::vector<std::string> buffers(window);
+  std::vector<std::size_t> ready(window, NO_BLOCK);
+  std::mutex mutex;
+  std::condition_variable block_ready;
+  std::exception_ptr error; // First block that failed to format
+
+  task_group group(scheduler);
+  auto format_block = [&](std::size_t block) {
+    group.run([&, block] {
+      const std::size_t slot = block % window;
+      std::exception_ptr failed;
+      try {
+        format_rows(buffers[slot], records, block * BLOCK_ROWS,
+                    std::min(records.size(), (block + 1) * BLOCK_ROWS));
+      } catch (...) {
+        failed = std::current_exception();
+      }
+      {
+        // Marked ready even when it failed, so the writer doesn't wait on
+        // it forever
+        std::lock_guard lock(mutex);
+        ready[slot] = block;
+        if (failed && !error) {
+          error = failed;
+        }
+      }
+      block_ready.notify_one();
+    });
+  };
+  for (std::size_t block = 0; block < std::min(window, blocks); ++block) {
+    format_block(block);
+  }
+
+  for (std::size_t block = 0; block < blocks; ++block) {
+    const std::size_t slot = block % window;
+    for (;;) {
+      std::unique_lock lock(mutex);
+      if (ready[slot] == block) {
+        break;
+      }
+      lock.unlock();
+      // Helps like task_group::wait(), so a worker busy with something
+      // long doesn't hold up the export
+      if (scheduler.run_one()) {
+        continue;
+      }
+      lock.lock();
+      block_ready.wait_for(lock, RECHECK,
+                           [&] { return ready[slot] == block; });
+    }
+    std::exception_ptr failed;
+    {
+      std::lock_guard lock(mutex);
+      failed = error;
+    }
+    if (failed) {
+      // The other tasks still use the buffers
+      group.wait();
+      std::rethrow_exception(failed);
+    }
+    const auto &buffer = buffers[slot];
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    stats.bytes += buffer.size();
+    if (block + window < blocks) {
+      format_block(block + window);
+    }
+  }
+  group.wait();
+
+  out.flush();
+  if (!out.good()) {
+    spdlog::error("Failed to write {}", path);
+    throw std::runtime_error("Failed to write csv file");
+  }
+  stats.elapsed = std::chrono::steady_clock::now() - start;
+  return stats;
+}
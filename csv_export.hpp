@@ -0,0 +1,37 @@
+#ifndef CSV_EXPORT_HPP
+#define CSV_EXPORT_HPP 1
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Record/Record.hpp"
+
+struct csv_export_stats_t {
+  std::size_t rows = 0;
+  uint64_t bytes = 0;
+  std::chrono::nanoseconds elapsed{0};
+
+  [[nodiscard]] auto mb_per_second() const -> double {
+    constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+    const std::chrono::duration<double> seconds = elapsed;
+    return seconds.count() > 0
+               ? static_cast<double>(bytes) / BYTES_PER_MB / seconds.count()
+               : 0;
+  }
+};
+
+// Writes a header line and one line per record. Blocks of rows are formatted
+// on the task scheduler, at most `threads` at a time (0 for one per worker),
+// into reused buffers and written in order by the calling thread. Numbers
+// are reprinted in their shortest form, strings lose the engine's quotes and
+// get CSV quoting when they need it. An exception formatting a block is
+// rethrown on the calling thread.
+auto write_csv(const std::string &path,
+               const std::vector<DB_ENGINE::Record> &records,
+               const std::vector<std::string> &names, std::size_t threads = 0)
+    -> csv_export_stats_t;
+
+#endif // CSV_EXPORT_HPP
@@ -0,0 +1,89 @@
+#ifndef FINGERPRINT_HPP
+#define FINGERPRINT_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "parser.tab.hh"
+
+// FNV-1a hash of a statement's token stream, with every literal replaced by
+// the same placeholder so `WHERE id = 1` and `WHERE id = 'x'` share a
+// fingerprint. Fed by the scanner one token at a time.
+class query_fingerprint {
+public:
+  void add(int kind, std::string_view text) {
+    using token = yy::parser::token;
+    switch (kind) {
+    case 0:
+      return;
+    case token::STRING:
+    case token::NUM:
+    case token::FLOATING:
+      mix(LITERAL);
+      return;
+    case token::ID:
+      mix(static_cast<uint64_t>(kind));
+      for (const char c : text) {
+        mix(static_cast<unsigned char>(c));
+      }
+      return;
+    case token::ENDL:
+      mix(static_cast<uint64_t>(kind));
+      m_last = m_hash;
+      m_hash = OFFSET_BASIS;
+      return;
+    default:
+      mix(static_cast<uint64_t>(kind));
+    }
+  }
+
+  // Fingerprint of the last statement whose ';' was lexed
+  [[nodiscard]] auto last() const -> uint64_t { return m_last; }
+
+private:
+  static constexpr uint64_t OFFSET_BASIS = 0xcbf29ce484222325;
+  static constexpr uint64_t PRIME = 0x100000001b3;
+  static constexpr uint64_t LITERAL = '?';
+
+  void mix(uint64_t value) { m_hash = (m_hash ^ value) * PRIME; }
+
+  uint64_t m_hash = OFFSET_BASIS;
+  uint64_t m_last = 0;
+};
+
+// Text of the statement being lexed, rebuilt from its tokens separated by
+// single spaces. Off by default since it copies every token.
+class text_capture {
+public:
+  void enable(bool enabled) { m_enabled = enabled; }
+
+  void add(int kind, std::string_view text) {
+    if (!m_enabled || kind == 0) {
+      return;
+    }
+    if (!m_current.empty()) {
+      m_current += ' ';
+    }
+    m_current.append(text);
+    if (kind == yy::parser::token::ENDL) {
+      m_last.swap(m_current);
+      m_current.clear();
+    }
+  }
+
+  [[nodiscard]] auto last() const -> const std::string & { return m_last; }
+
+  // The statement lexing stopped in, or the last one if its ';' was the last
+  // token read
+  [[nodiscard]] auto current() const -> const std::string & {
+    return m_current.empty() ? m_last : m_current;
+  }
+
+private:
+  bool m_enabled = false;
+  std::string m_current;
+  std::string m_last;
+};
+
+#endif // FINGERPRINT_HPP
@@ -0,0 +1,66 @@
+#ifndef FLEX_SCANNER_HPP
+#define FLEX_SCANNER_HPP 1
+
+#if !defined(yyFlexLexerOnce)
+#include <FlexLexer.h>
+#endif
+
+#include <string_view>
+
+#include "fingerprint.hpp"
+#include "location.hh"
+#include "parser.tab.hh"
+#include "trace.hpp"
+
+class flex_scanner : public yyFlexLexer {
+public:
+  flex_scanner(std::istream *in) : yyFlexLexer(in) {
+    loc = new yy::parser::location_type();
+  }
+
+  ~flex_scanner() override { delete loc; }
+
+  using FlexLexer::yylex;
+
+  virtual int yylex(yy::parser::semantic_type *const lval,
+                    yy::parser::location_type *location) {
+    trace_span span("yylex", "lex");
+    const int kind = next_token(lval, location);
+    m_fingerprint.add(kind, text());
+    m_text.add(kind, text());
+    return kind;
+  }
+
+  // Text of the last token returned by yylex
+  [[nodiscard]] auto text() const -> std::string_view {
+    return {YYText(), static_cast<std::size_t>(YYLeng())};
+  }
+
+  [[nodiscard]] auto fingerprint() const -> uint64_t {
+    return m_fingerprint.last();
+  }
+
+  void capture_text(bool enabled) { m_text.enable(enabled); }
+
+  // Only filled in while capture_text is on
+  [[nodiscard]] auto statement_text() const -> const std::string & {
+    return m_text.last();
+  }
+
+  // What was lexed of a statement that failed, capture_text must be on
+  [[nodiscard]] auto failed_statement_text() const -> const std::string & {
+    return m_text.current();
+  }
+
+private:
+  // Generated by flex from lexer.l
+  int next_token(yy::parser::semantic_type *const lval,
+                 yy::parser::location_type *location);
+
+  query_fingerprint m_fingerprint;
+  text_capture m_text;
+  yy::parser::semantic_type *yylval = nullptr;
+  yy::parser::location_type *loc = nullptr;
+};
+
+#endif // FLEX_SCANNER_HPP
@@ -0,0 +1,89 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP 1
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// HDR-style histogram: every power of two is split into SUB_BUCKETS linear
+// buckets, so any recorded value is known within 1/SUB_BUCKETS. Recording
+// is a handful of relaxed atomic adds and never takes a lock.
+class histogram {
+public:
+  static constexpr std::size_t SUB_BUCKET_BITS = 4;
+  static constexpr std::size_t SUB_BUCKETS = 1U << SUB_BUCKET_BITS;
+  static constexpr std::size_t BUCKETS =
+      (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  void record(uint64_t value) {
+    m_buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(
+                              max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  [[nodiscard]] auto count() const -> uint64_t {
+    return m_count.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] auto sum() const -> uint64_t {
+    return m_sum.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] auto max() const -> uint64_t {
+    return m_max.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] auto bucket_count(std::size_t bucket) const -> uint64_t {
+    return m_buckets[bucket].load(std::memory_order_relaxed);
+  }
+
+  // Upper bound of the bucket holding the q-th quantile, q in [0, 1]
+  [[nodiscard]] auto percentile(double q) const -> uint64_t {
+    const uint64_t total = count();
+    if (total == 0) {
+      return 0;
+    }
+    const auto rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(q * static_cast<double>(total) + 0.5));
+    uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+      seen += bucket_count(bucket);
+      if (seen >= rank) {
+        return std::min(upper_bound(bucket), max());
+      }
+    }
+    return max();
+  }
+
+  static constexpr auto bucket_of(uint64_t value) -> std::size_t {
+    if (value < SUB_BUCKETS) {
+      return static_cast<std::size_t>(value);
+    }
+    const auto shift = static_cast<std::size_t>(std::bit_width(value)) - 1 -
+                       SUB_BUCKET_BITS;
+    const auto sub = static_cast<std::size_t>(value >> shift) - SUB_BUCKETS;
+    return (shift + 1) * SUB_BUCKETS + sub;
+  }
+
+  // Largest value that falls in the bucket
+  static constexpr auto upper_bound(std::size_t bucket) -> uint64_t {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+    const std::size_t shift = bucket / SUB_BUCKETS - 1;
+    const uint64_t sub = bucket % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> m_buckets{};
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_sum{0};
+  std::atomic<uint64_t> m_max{0};
+};
+
+#endif // HISTOGRAM_HPP
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "flex_scanner.hpp"
+#include "simd_scanner.hpp"
+#include "statement_end.hpp"
+
+// Runs the flex and SIMD scanners over the same inputs and compares their
+// token streams: kind, text and value of every token. Files given on the
+// command line are checked after the built-in inputs. Splitting an input
+// with statement_end, as sql_parser -i does, must not change its tokens.
+// Numbers out of int range, or a '.' with no digits, throw from both
+// scanners and aren't covered: flex leaves the value half set and the
+// variant asserts.
+namespace {
+
+using token = yy::parser::token;
+
+// The places the SIMD scanner's chunking and wide loads could go wrong
+auto inputs() -> std::vector<std::string> {
+  std::vector<std::string> out{
+      "",
+      ";",
+      ";;;",
+      "select * from t;",
+      "SELECT * FROM t WHERE a = 1 AND b >= 2.5 OR c <> 'x';",
+      "create table t (id int primary key, name char(10), ok bool) on seq;",
+      "create index concurrently on t(id) avl;",
+      "explain analyze select a, b from t where a between 1 and 2;",
+      "show metrics; copy t to 'out.csv'; arrow t;",
+      "insert into t from 'data.bin'; update t set a = 1; delete from t;",
+      "drop table t; drop index t;",
+      // Quotes split across ';' chunks
+      "insert into t values ('a;b', 'c;;d');",
+      "insert into t values (';');select 1;",
+      "insert into t values ('it''s');",
+      "insert into t values ('multi\nline;\nstring');",
+      "select 'unterminated from t; select 1;",
+      "'",
+      "';",
+      "'';'",
+      "-- it's; not a comment;\nselect 1; 'x';",
+      // Keywords used as prefixes and suffixes of identifiers
+      "selection selects select_ insertx tox intox to2 onx on_hand",
+      "tables indexes columns seqs avls isams wherever andor ors",
+      "betweenness fromage intoa settle valuesx integer doubles chars",
+      "booleans primaryx primary_key primarykey xprimary",
+      "concurrentlyx explained analyzer showing metricsx arrows copying",
+      // "primary key" only matches exactly, as in flex
+      "primary key primary keys primary  key Primary Key PRIMARY KEY",
+      "primary\tkey primary\nkey primary",
+      // Mixed case keywords
+      "SeLeCt InSeRt UpDaTe DeLeTe CrEaTe DrOp tAbLe InDeX",
+      // Numbers
+      "0 12 1.5 .5 5. 007 1.2.3 12abc a12 1_2",
+      // Where the two scanners set different values, see describe
+      "column COLUMN Column colum columnn",
+      // Unknown characters
+      "select # from @t $ ! ~ \r ? é;",
+      // No ';' at the end
+      "select a from t",
+      "select a from t   ",
+      "select a from t\n",
+  };
+
+  // Tokens ending at and around every register boundary, with and without
+  // anything after them
+  for (std::size_t length = 1; length <= 70; ++length) {
+    const std::string id(length, 'a');
+    const std::string spaces(length, ' ');
+    const std::string digits(length % 9 + 1, '7');
+    out.push_back(id);
+    out.push_back(id + ";");
+    out.push_back("x" + spaces + "y");
+    out.push_back("x" + spaces);
+    out.push_back("'" + id + "'");
+    out.push_back("'" + id);
+    out.push_back(std::string(length, ';') + "select");
+    out.push_back(spaces + digits + "." + digits);
+    out.push_back(std::string(length, 'x') + "primary key");
+    out.push_back(spaces + "primary key");
+    out.push_back(id + "_1 " + id + "column " + spaces + "column");
+  }
+  return out;
+}
+
+auto is_column(std::string_view text) -> bool {
+  constexpr std::string_view COLUMN = "column";
+  return std::ranges::equal(text, COLUMN, [](char a, char b) {
+    return std::tolower(static_cast<unsigned char>(a)) == b;
+  });
+}
+
+// Takes the value out of lval, the variant asserts it is empty when it goes
+// out of scope
+template <typename T> auto take(yy::parser::semantic_type &lval) -> T {
+  T value = lval.as<T>();
+  lval.destroy<T>();
+  return value;
+}
+
+template <typename Scanner>
+auto describe(int kind, const Scanner &sc, yy::parser::semantic_type &lval)
+    -> std::string {
+  std::string out = std::to_string(kind) + " [" + std::string(sc.text()) + "]";
+  switch (kind) {
+  case token::ID:
+    // flex returns ID for "column" without setting a value, the SIMD scanner
+    // sets one. Read as no value when it is the token text, anything else
+    // shows up as a difference
+    if (is_column(sc.text())) {
+      if constexpr (std::is_same_v<Scanner, simd_scanner>) {
+        const auto value = take<std::string>(lval);
+        return value == sc.text() ? out : out + " = " + value;
+      }
+      return out;
+    }
+    return out + " = " + take<std::string>(lval);
+  case token::STRING:
+    return out + " = " + take<std::string>(lval);
+  case token::NUM:
+    return out + " = " + std::to_string(take<int>(lval));
+  case token::FLOATING:
+    return out + " = " + std::to_string(take<double>(lval));
+  default:
+    return out;
+  }
+}
+
+template <typename Scanner>
+auto lex(const std::string &input) -> std::vector<std::string> {
+  std::istringstream stream(input);
+  Scanner sc(&stream);
+  yy::parser::location_type location;
+  std::vector<std::string> tokens;
+  for (;;) {
+    yy::parser::semantic_type lval;
+    const int kind = sc.yylex(&lval, &location);
+    if (kind == 0) {
+      break;
+    }
+    tokens.push_back(describe(kind, sc, lval));
+  }
+  return tokens;
+}
+
+// Prints the first differing token, returns whether the streams match
+auto check(const std::string &name, const std::string &input) -> bool {
+  const auto flex = lex<flex_scanner>(input);
+  const auto simd = lex<simd_scanner>(input);
+  if (flex == simd) {
+    return true;
+  }
+  const auto [a, b] = std::ranges::mismatch(flex, simd);
+  const auto at = static_cast<std::size_t>(a - flex.begin());
+  std::cout << name << ": token " << at << " differs\n";
+  std::cout << "  flex: " << (a != flex.end() ? *a : "end of input") << "\n";
+  std::cout << "  simd: " << (b != simd.end() ? *b : "end of input") << "\n";
+  return false;
+}
+
+// Lexes each statement on its own, a split inside a string shows up as
+// different tokens
+auto check_split(const std::string &name, const std::string &input) -> bool {
+  std::vector<std::string> split;
+  std::size_t start = 0;
+  while (start < input.size()) {
+    const auto end = std::min(statement_end(input, start), input.size());
+    const auto tokens = lex<flex_scanner>(input.substr(start, end - start));
+    split.insert(split.end(), tokens.begin(), tokens.end());
+    start = end;
+  }
+  if (split == lex<flex_scanner>(input)) {
+    return true;
+  }
+  std::cout << name << ": statement_end splits inside a token\n";
+  return false;
+}
+
+} // namespace
+
+int main(const int argc, const char **argv) {
+  // Both scanners log every unknown character
+  spdlog::set_level(spdlog::level::warn);
+
+  std::size_t checked = 0;
+  std::size_t failed = 0;
+  const auto cases = inputs();
+  for (std::size_t i = 0; i < cases.size(); ++i) {
+    const auto name = "input " + std::to_string(i);
+    failed += check(name, cases[i]) && check_split(name, cases[i]) ? 0 : 1;
+    ++checked;
+  }
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file.is_open()) {
+      spdlog::error("Failed to open {}", argv[i]);
+      return EXIT_FAILURE;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    failed += check(argv[i], contents.str()) &&
+                      check_split(argv[i], contents.str())
+                  ? 0
+                  : 1;
+    ++checked;
+  }
+
+  std::cout << checked - failed << "/" << checked << " inputs lex the same\n";
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,24 +1,143 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
 
 #include "SqlParser.hpp"
+#include "metrics.hpp"
+#include "statement_end.hpp"
+#include "workload_capture.hpp"
+
+namespace {
+
+constexpr std::size_t INGEST_ROWS = 10000;
+constexpr std::chrono::milliseconds INGEST_DELAY{50};
+
+// Runs every complete statement of pending and drops it. Statements end
+// where the scanner would see the ';', so quotes are handled as it does.
+void run_statements(SqlParser &parser, std::string &pending) {
+  std::size_t start = 0;
+  for (std::size_t end = statement_end(pending);
+       end != std::string_view::npos; end = statement_end(pending, start)) {
+    const std::string_view statement(pending.data() + start, end - start);
+    try {
+      parser.clear();
+      parser.parse_query(statement);
+    } catch (const std::exception &e) {
+      spdlog::error("Statement failed: {}", e.what());
+    }
+    start = end;
+  }
+  pending.erase(0, start);
+}
+
+// Reads statements from stdin as they arrive. Inserts are applied in
+// micro-batches, which are flushed on time even while stdin is idle.
+auto stream_ingest(std::size_t max_rows, std::chrono::milliseconds max_delay)
+    -> int {
+  SqlParser parser;
+  parser.set_insert_batching(max_rows, max_delay);
+
+  constexpr std::size_t CHUNK = 64 * 1024;
+  std::array<char, CHUNK> chunk{};
+  std::string pending;
+  pollfd input{STDIN_FILENO, POLLIN, 0};
+  for (;;) {
+    const auto next = parser.flush_due_inserts();
+    int timeout = -1;
+    if (next != std::chrono::steady_clock::time_point::max()) {
+      const auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+          next - std::chrono::steady_clock::now());
+      timeout = static_cast<int>(std::max<int64_t>(wait.count(), 0));
+    }
+
+    const int ready = poll(&input, 1, timeout);
+    if (ready < 0 && errno != EINTR) {
+      spdlog::error("Polling stdin failed: {}", std::strerror(errno));
+      return EXIT_FAILURE;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    const auto bytes = read(STDIN_FILENO, chunk.data(), chunk.size());
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      break;
+    }
+    pending.append(chunk.data(), static_cast<std::size_t>(bytes));
+    run_statements(parser, pending);
+  }
+  parser.flush_inserts();
+
+  constexpr double NS_PER_MS = 1e6;
+  const auto &lag = metrics_registry::instance().ingest_lag();
+  auto ms = [&](double quantile) {
+    return static_cast<double>(lag.percentile(quantile)) / NS_PER_MS;
+  };
+  std::cout << "rows: " << lag.count() << "  lag (ms): p50 " << ms(0.5)
+            << "  p99 " << ms(0.99) << "  max "
+            << static_cast<double>(lag.max()) / NS_PER_MS << '\n';
+  return EXIT_SUCCESS;
+}
+
+// Runs a file, or stdin without one, recording every statement to capture
+// for sql_replay
+auto run_captured(const char *capture, const char *filename) -> int {
+  SqlParser parser;
+  try {
+    parser.set_workload_capture(std::make_shared<workload_capture>(capture),
+                                1);
+    if (filename != nullptr) {
+      parser.parse(filename);
+    } else {
+      parser.parse(std::cin);
+    }
+  } catch (const std::exception &e) {
+    spdlog::error("Statement failed: {}", e.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
 
 int main(const int argc, const char **argv) {
-  /** instantiate driver object **/
-  driver d;
+  if (argc >= 2 && std::strncmp(argv[1], "-i", 2) == 0) {
+    const std::size_t rows =
+        argc > 2 ? std::strtoul(argv[2], nullptr, 10) : INGEST_ROWS;
+    const std::chrono::milliseconds delay{
+        argc > 3 ? std::strtol(argv[3], nullptr, 10) : INGEST_DELAY.count()};
+    return stream_ingest(std::max<std::size_t>(rows, 1), delay);
+  }
+  if (argc >= 3 && std::strncmp(argv[1], "-c", 2) == 0) {
+    return run_captured(argv[2], argc > 3 ? argv[3] : nullptr);
+  }
+  SqlParser parser;
   if (argc == 2) {
 
     std::cout << "ok" << std::endl;
     /** example for piping input from terminal, i.e., using cat **/
     if (std::strncmp(argv[1], "-o", 2) == 0) {
       std::cout << argv[1] << std::endl;
-      d.parse(std::cin);
+      parser.parse(std::cin);
       std::cout << "ok" << std::endl;
     }
     /** simple help menu **/
     else if (std::strncmp(argv[1], "-h", 2) == 0) {
       std::cout << "use -o for pipe to std::cin\n";
+      std::cout << "use -i [rows] [ms] to stream inserts from std::cin in "
+                   "batches of rows or ms\n";
+      std::cout << "use -c <capture> [filename] to record the statements run "
+                   "for sql_replay\n";
       std::cout << "just give a filename to count from a file\n";
       std::cout << "use -h to get this menu\n";
       return (EXIT_SUCCESS);
@@ -26,11 +145,11 @@ int main(const int argc, const char **argv) {
     /** example reading input from a file **/
     else {
       /** assume file, prod code, use stat to check **/
-      d.parse(argv[1]);
+      parser.parse(argv[1]);
     }
   } else {
     /** exit with failure condition **/
-    d.parse(std::cin);
+    parser.parse(std::cin);
     return (EXIT_FAILURE);
   }
   return (EXIT_SUCCESS);
@@ -0,0 +1,203 @@
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+#include "metrics.hpp"
+#include "scheduler.hpp"
+
+namespace {
+
+// Prometheus buckets, powers of two from ~1us to ~69s. They line up with
+// the histogram's own bucket edges so the counts are exact.
+constexpr unsigned FIRST_BUCKET_BIT = 10;
+constexpr unsigned LAST_BUCKET_BIT = 36;
+
+void write_histogram(std::string &text, std::string_view name,
+                     std::string_view label, const histogram &values) {
+  constexpr double NS_PER_S = 1e9;
+  auto out = std::back_inserter(text);
+  // The label goes in front of le, and series without one get no braces
+  const std::string bucket_labels =
+      label.empty() ? std::string{} : fmt::format("{},", label);
+  const std::string series_labels =
+      label.empty() ? std::string{} : fmt::format("{{{}}}", label);
+
+  uint64_t cumulative = 0;
+  std::size_t bucket = 0;
+  for (unsigned bit = FIRST_BUCKET_BIT; bit <= LAST_BUCKET_BIT; ++bit) {
+    // Every value below 2^bit, so le is the largest of them. Printed at
+    // full precision, a rounded bound would claim values it doesn't hold.
+    const uint64_t bound = uint64_t{1} << bit;
+    for (; bucket < histogram::bucket_of(bound); ++bucket) {
+      cumulative += values.bucket_count(bucket);
+    }
+    fmt::format_to(out, "{}_bucket{{{}le=\"{}\"}} {}\n", name, bucket_labels,
+                   static_cast<double>(bound - 1) / NS_PER_S, cumulative);
+  }
+  fmt::format_to(out, "{}_bucket{{{}le=\"+Inf\"}} {}\n", name, bucket_labels,
+                 values.count());
+  fmt::format_to(out, "{}_sum{} {}\n", name, series_labels,
+                 static_cast<double>(values.sum()) / NS_PER_S);
+  fmt::format_to(out, "{}_count{} {}\n", name, series_labels, values.count());
+}
+
+void write_counter(std::string &text, std::string_view name,
+                   std::string_view help, uint64_t value) {
+  fmt::format_to(std::back_inserter(text),
+                 "# HELP {0} {1}\n# TYPE {0} counter\n{0} {2}\n", name, help,
+                 value);
+}
+
+void write_gauge(std::string &text, std::string_view name,
+                 std::string_view help, double value) {
+  fmt::format_to(std::back_inserter(text),
+                 "# HELP {0} {1}\n# TYPE {0} gauge\n{0} {2:g}\n", name, help,
+                 value);
+}
+
+} // namespace
+
+auto metrics_registry::instance() -> metrics_registry & {
+  static metrics_registry registry;
+  return registry;
+}
+
+metrics_registry::~metrics_registry() { stop_dump(); }
+
+auto metrics_registry::find_or_create(histograms_t &histograms,
+                                      std::string_view label) -> histogram & {
+  {
+    std::shared_lock lock(m_mutex);
+    auto it = histograms.find(label);
+    if (it != histograms.end()) {
+      return *it->second;
+    }
+  }
+  std::unique_lock lock(m_mutex);
+  auto &slot = histograms[std::string(label)];
+  if (!slot) {
+    slot = std::make_unique<histogram>();
+  }
+  return *slot;
+}
+
+void metrics_registry::record_statement(const statement_stats_t &stats) {
+  const auto latency_ns = static_cast<uint64_t>(stats.total.count());
+  find_or_create(m_statement_latency, stats.type).record(latency_ns);
+  if (!stats.table.empty()) {
+    find_or_create(m_table_latency, stats.table).record(latency_ns);
+  }
+
+  uint64_t index_probes = 0;
+  for (const auto &step : stats.plan) {
+    index_probes += step.probes;
+  }
+  m_rows_read.fetch_add(stats.rows_examined, std::memory_order_relaxed);
+  m_rows_returned.fetch_add(stats.rows_returned, std::memory_order_relaxed);
+  m_index_probes.fetch_add(index_probes, std::memory_order_relaxed);
+  m_bytes_written.fetch_add(stats.bytes_written, std::memory_order_relaxed);
+}
+
+void metrics_registry::record_ingest_batch(std::size_t rows) {
+  m_ingest_batches.fetch_add(1, std::memory_order_relaxed);
+  m_ingest_rows.fetch_add(rows, std::memory_order_relaxed);
+}
+
+auto metrics_registry::prometheus() -> std::string {
+  std::string text;
+  {
+    std::shared_lock lock(m_mutex);
+    text += "# HELP sql_statement_duration_seconds Statement latency by "
+            "statement type\n";
+    text += "# TYPE sql_statement_duration_seconds histogram\n";
+    for (const auto &[type, values] : m_statement_latency) {
+      write_histogram(text, "sql_statement_duration_seconds",
+                      fmt::format("type=\"{}\"", type), *values);
+    }
+    text += "# HELP sql_table_duration_seconds Statement latency by table\n";
+    text += "# TYPE sql_table_duration_seconds histogram\n";
+    for (const auto &[table, values] : m_table_latency) {
+      write_histogram(text, "sql_table_duration_seconds",
+                      fmt::format("table=\"{}\"", table), *values);
+    }
+  }
+  write_counter(text, "sql_rows_read_total",
+                "Rows returned by the engine before merging", m_rows_read);
+  write_counter(text, "sql_rows_returned_total", "Rows returned to clients",
+                m_rows_returned);
+  write_counter(text, "sql_index_probes_total",
+                "Index searches and range searches", m_index_probes);
+  write_counter(text, "sql_bytes_written_total",
+                "Bytes of inserted values and loaded files", m_bytes_written);
+  write_counter(text, "sql_ingest_batches_total",
+                "Micro-batches of buffered inserts applied", m_ingest_batches);
+  write_counter(text, "sql_ingest_rows_total",
+                "Rows applied through micro-batches", m_ingest_rows);
+  text += "# HELP sql_ingest_lag_seconds Time from parsing an INSERT to "
+          "applying its batch\n";
+  text += "# TYPE sql_ingest_lag_seconds histogram\n";
+  write_histogram(text, "sql_ingest_lag_seconds", {}, m_ingest_lag);
+
+  const auto scheduler = task_scheduler::stats();
+  write_gauge(text, "sql_scheduler_workers", "Task scheduler worker threads",
+              static_cast<double>(scheduler.workers));
+  write_counter(text, "sql_scheduler_tasks_total",
+                "Tasks run by the task scheduler", scheduler.tasks);
+  write_counter(text, "sql_scheduler_steals_total",
+                "Tasks taken from another worker's deque", scheduler.steals);
+  text += "# HELP sql_scheduler_busy_seconds_total Time workers spent "
+          "running tasks\n";
+  text += "# TYPE sql_scheduler_busy_seconds_total counter\n";
+  fmt::format_to(std::back_inserter(text),
+                 "sql_scheduler_busy_seconds_total {:g}\n",
+                 std::chrono::duration<double>(scheduler.busy).count());
+  write_gauge(text, "sql_scheduler_utilization",
+              "Share of worker time spent running tasks since start",
+              scheduler.utilization());
+  return text;
+}
+
+void metrics_registry::start_dump(std::string path,
+                                  std::chrono::milliseconds interval) {
+  stop_dump();
+  m_dump_path = std::move(path);
+  m_dump_interval = interval;
+  m_dump_stop = false;
+  m_dump_thread = std::thread([this] {
+    std::unique_lock lock(m_dump_mutex);
+    while (!m_dump_cv.wait_for(lock, m_dump_interval,
+                               [this] { return m_dump_stop; })) {
+      dump();
+    }
+  });
+}
+
+void metrics_registry::stop_dump() {
+  if (!m_dump_thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard lock(m_dump_mutex);
+    m_dump_stop = true;
+  }
+  m_dump_cv.notify_one();
+  m_dump_thread.join();
+  dump(); // What changed since the last interval, or a run shorter than one
+}
+
+void metrics_registry::dump() {
+  const std::string tmp_path = m_dump_path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::trunc);
+    out << prometheus();
+    if (!out.good()) {
+      spdlog::error("Failed to write metrics to {}", tmp_path);
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tmp_path, m_dump_path, error);
+  if (error) {
+    spdlog::error("Failed to replace {}: {}", m_dump_path, error.message());
+  }
+}
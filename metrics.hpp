@@ -0,0 +1,80 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP 1
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "histogram.hpp"
+#include "query_stats.hpp"
+
+// Process-wide metrics fed by every session, exported in the Prometheus
+// text exposition format. Histograms are created on first use and never
+// removed, so recording only takes a shared lock to find them.
+class metrics_registry {
+public:
+  static auto instance() -> metrics_registry &;
+
+  metrics_registry(const metrics_registry &) = delete;
+  auto operator=(const metrics_registry &) -> metrics_registry & = delete;
+
+  void record_statement(const statement_stats_t &stats);
+
+  // A micro-batch of buffered inserts was applied, lag is how long each of
+  // its rows waited since its INSERT was parsed
+  void record_ingest_batch(std::size_t rows);
+  void record_ingest_lag(std::chrono::nanoseconds lag) {
+    m_ingest_lag.record(static_cast<uint64_t>(lag.count()));
+  }
+  [[nodiscard]] auto ingest_lag() const -> const histogram & {
+    return m_ingest_lag;
+  }
+
+  [[nodiscard]] auto prometheus() -> std::string;
+
+  // Rewrites path with prometheus() every interval, replacing it atomically
+  // as the node exporter textfile collector expects. stop_dump writes it
+  // once more.
+  void start_dump(std::string path, std::chrono::milliseconds interval);
+  void stop_dump();
+
+private:
+  using histograms_t = std::map<std::string, std::unique_ptr<histogram>,
+                                std::less<>>;
+
+  metrics_registry() = default;
+  ~metrics_registry();
+
+  auto find_or_create(histograms_t &histograms, std::string_view label)
+      -> histogram &;
+  void dump();
+
+  std::shared_mutex m_mutex;
+  histograms_t m_statement_latency;
+  histograms_t m_table_latency;
+
+  std::atomic<uint64_t> m_rows_read{0};
+  std::atomic<uint64_t> m_rows_returned{0};
+  std::atomic<uint64_t> m_index_probes{0};
+  std::atomic<uint64_t> m_bytes_written{0};
+  histogram m_ingest_lag;
+  std::atomic<uint64_t> m_ingest_batches{0};
+  std::atomic<uint64_t> m_ingest_rows{0};
+
+  std::string m_dump_path;
+  std::chrono::milliseconds m_dump_interval{0};
+  std::mutex m_dump_mutex;
+  std::condition_variable m_dump_cv;
+  bool m_dump_stop = false;
+  std::thread m_dump_thread;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "morsel.hpp"
+#include "operators.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+namespace {
+
+// Past this many distinct values in a morsel, as many as a columnar result
+// would still encode, new values are checked without getting a code
+constexpr std::size_t MAX_CODES = MORSEL_ROWS / 2;
+
+// One value_predicate_t's codes for a morsel, and whether each code matched
+struct dictionary_t {
+  std::unordered_map<std::string, int32_t> codes;
+  std::vector<uint8_t> matches;
+};
+
+auto matches_by_value(const value_predicate_t &by_value,
+                      dictionary_t &dictionary, const DB_ENGINE::Record &row)
+    -> bool {
+  const auto &value = row.m_fields[by_value.column];
+  const auto known = dictionary.codes.find(value);
+  if (known != dictionary.codes.end()) {
+    return dictionary.matches[static_cast<std::size_t>(known->second)] != 0;
+  }
+  const bool matches = by_value.predicate(row);
+  if (dictionary.codes.size() < MAX_CODES) {
+    dictionary.codes.emplace(value,
+                             static_cast<int32_t>(dictionary.matches.size()));
+    dictionary.matches.push_back(matches ? 1 : 0);
+  }
+  return matches;
+}
+
+void run_morsel(std::span<DB_ENGINE::Record> rows,
+                const std::function<bool(const DB_ENGINE::Record &)>
+                    &predicate,
+                std::span<const std::size_t> columns,
+                std::span<const value_predicate_t> by_value,
+                std::vector<DB_ENGINE::Record> &out) {
+  trace_span span("morsel", "execute");
+  std::vector<dictionary_t> dictionaries(by_value.size());
+  collect_sink collect(out);
+  project_op project({columns.begin(), columns.end()}, collect);
+  filter_op filter(
+      [&](const DB_ENGINE::Record &row) {
+        for (std::size_t i = 0; i < by_value.size(); ++i) {
+          if (!matches_by_value(by_value[i], dictionaries[i], row)) {
+            return false;
+          }
+        }
+        return !predicate || predicate(row);
+      },
+      project);
+  push_rows(rows, filter);
+  filter.finish();
+}
+
+} // namespace
+
+auto filter_project(std::vector<DB_ENGINE::Record> &&rows,
+                    const std::function<bool(const DB_ENGINE::Record &)>
+                        &predicate,
+                    std::span<const std::size_t> columns,
+                    std::span<const value_predicate_t> by_value)
+    -> std::vector<DB_ENGINE::Record> {
+  const std::size_t morsels = (rows.size() + MORSEL_ROWS - 1) / MORSEL_ROWS;
+  std::vector<std::vector<DB_ENGINE::Record>> outputs(morsels);
+  auto morsel = [&](std::size_t index) {
+    const std::size_t first = index * MORSEL_ROWS;
+    const std::size_t last = std::min(rows.size(), first + MORSEL_ROWS);
+    run_morsel(std::span(rows).subspan(first, last - first), predicate,
+               columns, by_value, outputs[index]);
+  };
+
+  if (morsels == 1) {
+    morsel(0);
+  } else if (morsels > 1) {
+    task_group group;
+    for (std::size_t i = 0; i < morsels; ++i) {
+      group.run([&, i] { morsel(i); });
+    }
+    group.wait();
+  }
+
+  std::size_t total = 0;
+  for (const auto &output : outputs) {
+    total += output.size();
+  }
+  std::vector<DB_ENGINE::Record> result;
+  result.reserve(total);
+  for (auto &output : outputs) {
+    std::ranges::move(output, std::back_inserter(result));
+  }
+  return result;
+}
+
+auto widen_predicate(
+    std::function<bool(const DB_ENGINE::Record &)> predicate,
+    std::vector<std::size_t> positions, std::size_t width)
+    -> std::function<bool(const DB_ENGINE::Record &)> {
+  return [predicate = std::move(predicate), positions = std::move(positions),
+          width](const DB_ENGINE::Record &record) {
+    // Per thread, morsels are filtered on several at once
+    thread_local DB_ENGINE::Record wide;
+    wide.m_fields.resize(width);
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      wide.m_fields[positions[i]] = record.m_fields[i];
+    }
+    return predicate(wide);
+  };
+}
@@ -0,0 +1,43 @@
+#ifndef MORSEL_HPP
+#define MORSEL_HPP 1
+
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "Record/Record.hpp"
+
+// Rows per morsel, small enough that an expensive predicate on one part of
+// the table doesn't leave the other workers idle
+constexpr std::size_t MORSEL_ROWS = 10 * 1024;
+
+// A predicate that only reads the field at column, such as a comparison
+// with a string literal. filter_project runs it once per distinct value of
+// a morsel and matches rows by their value's code, the way a dictionary
+// encoded column is filtered.
+struct value_predicate_t {
+  std::size_t column;
+  std::function<bool(const DB_ENGINE::Record &)> predicate;
+};
+
+// Filters rows with predicate, if set, and every one of by_value, and keeps
+// the fields at columns, in that order. Morsels are tasks on the task
+// scheduler, pulled by whichever worker is free, each running its filter and
+// projection to completion. The result keeps the input order.
+auto filter_project(std::vector<DB_ENGINE::Record> &&rows,
+                    const std::function<bool(const DB_ENGINE::Record &)>
+                        &predicate,
+                    std::span<const std::size_t> columns,
+                    std::span<const value_predicate_t> by_value = {})
+    -> std::vector<DB_ENGINE::Record>;
+
+// The engine's predicate over records holding only some columns, each
+// field copied to the position it has in a full record of width fields.
+// Fields the predicate doesn't read are left as they are.
+auto widen_predicate(
+    std::function<bool(const DB_ENGINE::Record &)> predicate,
+    std::vector<std::size_t> positions, std::size_t width)
+    -> std::function<bool(const DB_ENGINE::Record &)>;
+
+#endif // MORSEL_HPP
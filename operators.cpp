@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <limits>
+
+#include "operators.hpp"
+
+namespace {
+
+constexpr std::size_t EMPTY = std::numeric_limits<std::size_t>::max();
+
+auto to_number(std::string_view value, double &out) -> bool {
+  const char *end = value.data() + value.size();
+  return !value.empty() && std::from_chars(value.data(), end, out).ptr == end;
+}
+
+// Spelling shared by every value value_less holds equal: numbers by their
+// value, so 1, 1.0 and 01 hash and group together
+void value_key(std::string_view value, std::string &out) {
+  double number = 0;
+  if (!to_number(value, number)) {
+    out.append(value);
+    return;
+  }
+  if (number == 0) {
+    number = 0; // -0 is 0
+  }
+  std::array<char, 32> buffer{};
+  const auto end =
+      std::to_chars(buffer.data(), buffer.data() + buffer.size(), number).ptr;
+  out.append(buffer.data(), end);
+}
+
+} // namespace
+
+auto value_less(std::string_view a, std::string_view b) -> bool {
+  double x = 0;
+  double y = 0;
+  if (to_number(a, x) && to_number(b, y)) {
+    return x < y;
+  }
+  return a < b;
+}
+
+auto push_rows(std::span<DB_ENGINE::Record> rows, row_sink &sink) -> bool {
+  for (std::size_t first = 0; first < rows.size(); first += BATCH_ROWS) {
+    const std::size_t count = std::min(BATCH_ROWS, rows.size() - first);
+    if (!sink.push(rows.subspan(first, count))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto collect_sink::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  m_out.insert(m_out.end(), std::make_move_iterator(batch.begin()),
+               std::make_move_iterator(batch.end()));
+  return true;
+}
+
+auto filter_op::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  std::size_t kept = 0;
+  for (auto &row : batch) {
+    if (m_predicate(row)) {
+      if (&batch[kept] != &row) {
+        batch[kept] = std::move(row);
+      }
+      ++kept;
+    }
+  }
+  return kept == 0 || m_next.push(batch.first(kept));
+}
+
+project_op::project_op(std::vector<std::size_t> columns, row_sink &next)
+    : m_columns(std::move(columns)),
+      m_in_place(std::ranges::adjacent_find(m_columns, std::greater_equal{}) ==
+                 m_columns.end()),
+      m_next(next) {}
+
+auto project_op::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  for (auto &row : batch) {
+    auto &fields = row.m_fields;
+    if (m_in_place) {
+      // Column i is at or after position i, so moving down never
+      // overwrites a field still to be read
+      for (std::size_t i = 0; i < m_columns.size(); ++i) {
+        if (m_columns[i] != i) {
+          fields[i] = std::move(fields[m_columns[i]]);
+        }
+      }
+      fields.resize(m_columns.size());
+      continue;
+    }
+    m_scratch.clear();
+    for (const auto column : m_columns) {
+      m_scratch.push_back(std::move(fields[column]));
+    }
+    fields.swap(m_scratch);
+  }
+  return m_next.push(batch);
+}
+
+auto limit_op::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  const std::size_t skipped = std::min(m_offset, batch.size());
+  m_offset -= skipped;
+  batch = batch.subspan(skipped);
+  const std::size_t passed = std::min(m_count, batch.size());
+  m_count -= passed;
+  if (passed != 0 && !m_next.push(batch.first(passed))) {
+    return false;
+  }
+  return m_count != 0;
+}
+
+union_op::union_op(std::vector<DB_ENGINE::Record> &out,
+                   std::vector<std::size_t> &slots)
+    : m_out(out), m_slots(slots) {
+  rehash(m_out.size());
+}
+
+void union_op::rehash(std::size_t rows) {
+  // At most half full. Duplicates already in out are kept, only rows
+  // pushed later are dropped.
+  m_mask = std::bit_ceil(2 * rows + 1) - 1;
+  m_slots.assign(m_mask + 1, EMPTY);
+  for (std::size_t i = 0; i < m_out.size(); ++i) {
+    insert_unique(i);
+  }
+}
+
+auto union_op::insert_unique(std::size_t index) -> bool {
+  const DB_ENGINE::RecordHash hasher;
+  std::size_t slot = hasher(m_out[index]) & m_mask;
+  for (; m_slots[slot] != EMPTY; slot = (slot + 1) & m_mask) {
+    if (m_out[m_slots[slot]] == m_out[index]) {
+      return false;
+    }
+  }
+  m_slots[slot] = index;
+  return true;
+}
+
+auto union_op::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  if (2 * (m_out.size() + batch.size()) + 1 > m_mask + 1) {
+    rehash(m_out.size() + batch.size());
+  }
+  for (auto &row : batch) {
+    m_out.push_back(std::move(row));
+    if (!insert_unique(m_out.size() - 1)) {
+      m_out.pop_back();
+    }
+  }
+  return true;
+}
+
+auto sort_op::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  m_rows.insert(m_rows.end(), std::make_move_iterator(batch.begin()),
+                std::make_move_iterator(batch.end()));
+  return true;
+}
+
+void sort_op::finish() {
+  std::ranges::stable_sort(m_rows, [&](const auto &a, const auto &b) {
+    for (const auto &key : m_keys) {
+      const auto &x = a.m_fields[key.column];
+      const auto &y = b.m_fields[key.column];
+      if (value_less(x, y)) {
+        return !key.descending;
+      }
+      if (value_less(y, x)) {
+        return key.descending;
+      }
+    }
+    return false;
+  });
+  push_rows(m_rows, m_next);
+  m_rows.clear();
+  m_next.finish();
+}
+
+auto aggregate_op::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  for (const auto &row : batch) {
+    // Length prefixed so no value can run into the next one
+    m_key.clear();
+    for (const auto column : m_group_columns) {
+      m_value.clear();
+      value_key(row.m_fields[column], m_value);
+      m_key += std::to_string(m_value.size());
+      m_key += ':';
+      m_key += m_value;
+    }
+    auto [it, inserted] = m_groups.try_emplace(m_key);
+    if (inserted) {
+      for (const auto column : m_group_columns) {
+        it->second.key.m_fields.push_back(row.m_fields[column]);
+      }
+      it->second.states.resize(m_aggregates.size());
+    }
+    update(it->second, row);
+  }
+  return true;
+}
+
+void aggregate_op::update(group_t &group, const DB_ENGINE::Record &row) {
+  for (std::size_t i = 0; i < m_aggregates.size(); ++i) {
+    const auto &spec = m_aggregates[i];
+    auto &state = group.states[i];
+    if (spec.function == aggregate_t::COUNT) {
+      ++state.count;
+      continue;
+    }
+    const auto &value = row.m_fields[spec.column];
+    double number = 0;
+    if (to_number(value, number)) {
+      state.sum += number;
+    }
+    if (state.count == 0 || value_less(value, state.min)) {
+      state.min = value;
+    }
+    if (state.count == 0 || value_less(state.max, value)) {
+      state.max = value;
+    }
+    ++state.count;
+  }
+}
+
+void aggregate_op::finish() {
+  if (m_groups.empty() && m_group_columns.empty()) {
+    auto &group = m_groups[{}];
+    group.states.resize(m_aggregates.size());
+  }
+
+  std::vector<DB_ENGINE::Record> rows;
+  rows.reserve(m_groups.size());
+  for (auto &[key, group] : m_groups) {
+    auto &row = rows.emplace_back(std::move(group.key));
+    for (std::size_t i = 0; i < m_aggregates.size(); ++i) {
+      const auto &state = group.states[i];
+      switch (m_aggregates[i].function) {
+      case aggregate_t::COUNT:
+        row.m_fields.push_back(std::to_string(state.count));
+        break;
+      case aggregate_t::SUM:
+        row.m_fields.push_back(std::to_string(state.sum));
+        break;
+      case aggregate_t::MIN:
+        row.m_fields.push_back(state.min);
+        break;
+      case aggregate_t::MAX:
+        row.m_fields.push_back(state.max);
+        break;
+      case aggregate_t::AVG:
+        row.m_fields.push_back(
+            state.count == 0
+                ? std::string{}
+                : std::to_string(state.sum /
+                                 static_cast<double>(state.count)));
+        break;
+      }
+    }
+  }
+  m_groups.clear();
+  push_rows(rows, m_next);
+  m_next.finish();
+}
+
+hash_join_op::hash_join_op(std::size_t build_column, std::size_t probe_column,
+                           row_sink &next)
+    : m_build_column(build_column), m_probe_column(probe_column),
+      m_build(*this), m_next(next) {}
+
+auto hash_join_op::build_sink::push(std::span<DB_ENGINE::Record> batch)
+    -> bool {
+  auto &join = m_join;
+  for (auto &row : batch) {
+    std::string key;
+    value_key(row.m_fields[join.m_build_column], key);
+    join.m_table.emplace(std::move(key), join.m_build_rows.size());
+    join.m_build_rows.push_back(std::move(row));
+  }
+  return true;
+}
+
+auto hash_join_op::push(std::span<DB_ENGINE::Record> batch) -> bool {
+  for (const auto &row : batch) {
+    m_key.clear();
+    value_key(row.m_fields[m_probe_column], m_key);
+    const auto [first, last] = m_table.equal_range(m_key);
+    for (auto match = first; match != last; ++match) {
+      const auto &build = m_build_rows[match->second].m_fields;
+      auto &fields = m_out.emplace_back().m_fields;
+      fields.reserve(row.m_fields.size() + build.size());
+      fields.insert(fields.end(), row.m_fields.begin(), row.m_fields.end());
+      fields.insert(fields.end(), build.begin(), build.end());
+    }
+    if (m_out.size() >= BATCH_ROWS) {
+      const bool more = m_next.push(m_out);
+      m_out.clear();
+      if (!more) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void hash_join_op::finish() {
+  if (!m_out.empty()) {
+    m_next.push(m_out);
+    m_out.clear();
+  }
+  m_next.finish();
+}
@@ -0,0 +1,222 @@
+#ifndef OPERATORS_HPP
+#define OPERATORS_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Record/Record.hpp"
+
+// Push-based operators. A pipeline is built from its sink backwards, each
+// operator holding the next one, and batches of rows are pushed into its
+// head. Operators work on the batch in place and pass it on, so a batch
+// stays in cache from the source to the sink. Only sort, aggregate and the
+// build side of a join hold rows back. The engine has no cursor to pull
+// from, sources are the vectors it returns, pushed with push_rows().
+
+// Rows per batch pushed by push_rows(), a few pages of records
+constexpr std::size_t BATCH_ROWS = 1024;
+
+// Orders values as the grammar spells them, numbers by their value
+auto value_less(std::string_view a, std::string_view b) -> bool;
+
+class row_sink {
+public:
+  row_sink() = default;
+  virtual ~row_sink() = default;
+  row_sink(const row_sink &) = delete;
+  auto operator=(const row_sink &) -> row_sink & = delete;
+
+  // May move from the batch's rows. Returns false once no more rows are
+  // wanted, sources stop pushing then.
+  virtual auto push(std::span<DB_ENGINE::Record> batch) -> bool = 0;
+
+  // After the last push, passed down so a sink holding rows back can emit
+  // them
+  virtual void finish() {}
+};
+
+// Pushes rows in batches of BATCH_ROWS, false if the sink stopped early.
+// Doesn't call finish(), a pipeline may have several sources.
+auto push_rows(std::span<DB_ENGINE::Record> rows, row_sink &sink) -> bool;
+
+// Moves every row into a vector
+class collect_sink : public row_sink {
+public:
+  explicit collect_sink(std::vector<DB_ENGINE::Record> &out) : m_out(out) {}
+
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+
+private:
+  std::vector<DB_ENGINE::Record> &m_out;
+};
+
+class filter_op : public row_sink {
+public:
+  using predicate_t = std::function<bool(const DB_ENGINE::Record &)>;
+
+  filter_op(predicate_t predicate, row_sink &next)
+      : m_predicate(std::move(predicate)), m_next(next) {}
+
+  // Compacts the matching rows to the front of the batch
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+  void finish() override { m_next.finish(); }
+
+private:
+  predicate_t m_predicate;
+  row_sink &m_next;
+};
+
+// Keeps the fields at columns, in that order
+class project_op : public row_sink {
+public:
+  project_op(std::vector<std::size_t> columns, row_sink &next);
+
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+  void finish() override { m_next.finish(); }
+
+private:
+  std::vector<std::size_t> m_columns;
+  bool m_in_place; // Increasing columns are moved down without a copy
+  std::vector<std::string> m_scratch;
+  row_sink &m_next;
+};
+
+// Skips offset rows, then passes count rows and stops its sources
+class limit_op : public row_sink {
+public:
+  limit_op(std::size_t count, std::size_t offset, row_sink &next)
+      : m_count(count), m_offset(offset), m_next(next) {}
+
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+  void finish() override { m_next.finish(); }
+
+private:
+  std::size_t m_count;
+  std::size_t m_offset;
+  row_sink &m_next;
+};
+
+// Collects the rows of every source that pushes into it, dropping those
+// equal to one already collected. Duplicates are found by looking in out
+// itself, so nothing is copied. slots is scratch space that can be kept
+// between queries.
+class union_op : public row_sink {
+public:
+  union_op(std::vector<DB_ENGINE::Record> &out,
+           std::vector<std::size_t> &slots);
+
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+
+private:
+  void rehash(std::size_t rows);
+  auto insert_unique(std::size_t index) -> bool;
+
+  std::vector<DB_ENGINE::Record> &m_out;
+  std::vector<std::size_t> &m_slots;
+  std::size_t m_mask = 0;
+};
+
+struct sort_key_t {
+  std::size_t column;
+  bool descending = false;
+};
+
+// Holds every row, sorts them with value_less on finish() and pushes them
+class sort_op : public row_sink {
+public:
+  sort_op(std::vector<sort_key_t> keys, row_sink &next)
+      : m_keys(std::move(keys)), m_next(next) {}
+
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+  void finish() override;
+
+private:
+  std::vector<sort_key_t> m_keys;
+  std::vector<DB_ENGINE::Record> m_rows;
+  row_sink &m_next;
+};
+
+enum class aggregate_t { COUNT, SUM, MIN, MAX, AVG };
+
+struct aggregate_spec_t {
+  aggregate_t function;
+  std::size_t column = 0; // Ignored by COUNT
+};
+
+// Hash aggregation. Emits one row per group on finish(): the group columns
+// followed by one field per aggregate, in the order they were given.
+// Without group columns there is a single group, even with no rows.
+class aggregate_op : public row_sink {
+public:
+  aggregate_op(std::vector<std::size_t> group_columns,
+               std::vector<aggregate_spec_t> aggregates, row_sink &next)
+      : m_group_columns(std::move(group_columns)),
+        m_aggregates(std::move(aggregates)), m_next(next) {}
+
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+  void finish() override;
+
+private:
+  struct state_t {
+    uint64_t count = 0;
+    double sum = 0;
+    std::string min;
+    std::string max;
+  };
+
+  struct group_t {
+    DB_ENGINE::Record key;
+    std::vector<state_t> states;
+  };
+
+  void update(group_t &group, const DB_ENGINE::Record &row);
+
+  std::vector<std::size_t> m_group_columns;
+  std::vector<aggregate_spec_t> m_aggregates;
+  std::unordered_map<std::string, group_t> m_groups;
+  std::string m_key;
+  std::string m_value;
+  row_sink &m_next;
+};
+
+// Inner equi-join. The build side is pushed into build_side() first and
+// kept in a hash table, then every probe row pushed into the join comes
+// out once per match as its fields followed by the build row's.
+class hash_join_op : public row_sink {
+public:
+  hash_join_op(std::size_t build_column, std::size_t probe_column,
+               row_sink &next);
+
+  auto build_side() -> row_sink & { return m_build; }
+
+  auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+  void finish() override;
+
+private:
+  class build_sink : public row_sink {
+  public:
+    explicit build_sink(hash_join_op &join) : m_join(join) {}
+    auto push(std::span<DB_ENGINE::Record> batch) -> bool override;
+
+  private:
+    hash_join_op &m_join;
+  };
+
+  std::size_t m_build_column;
+  std::size_t m_probe_column;
+  std::vector<DB_ENGINE::Record> m_build_rows;
+  // Keyed on the values' value_less spelling, so 1 joins with 1.0
+  std::unordered_multimap<std::string, std::size_t> m_table;
+  std::string m_key;
+  build_sink m_build;
+  std::vector<DB_ENGINE::Record> m_out; // Reused output batch
+  row_sink &m_next;
+};
+
+#endif // OPERATORS_HPP
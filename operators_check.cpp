@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "morsel.hpp"
+#include "operators.hpp"
+
+// Runs small pipelines through the push operators, and filter_project over
+// several morsels, and compares what reaches the sink with the rows
+// expected. Values are compared as the grammar spells them, so 1 and 1.0
+// must sort, group and join as the same number.
+namespace {
+
+using rows_t = std::vector<DB_ENGINE::Record>;
+
+auto make_rows(std::initializer_list<std::vector<std::string>> fields)
+    -> rows_t {
+  rows_t out;
+  for (const auto &row : fields) {
+    out.emplace_back().m_fields = row;
+  }
+  return out;
+}
+
+auto fields(const rows_t &rows) -> std::vector<std::vector<std::string>> {
+  std::vector<std::vector<std::string>> out;
+  out.reserve(rows.size());
+  for (const auto &row : rows) {
+    out.push_back(row.m_fields);
+  }
+  return out;
+}
+
+auto show(const std::vector<std::vector<std::string>> &rows) -> std::string {
+  std::string out;
+  for (const auto &row : rows) {
+    out += "  (";
+    for (std::size_t i = 0; i < row.size(); ++i) {
+      out += (i == 0 ? "" : ", ") + row[i];
+    }
+    out += ")\n";
+  }
+  return out.empty() ? "  no rows\n" : out;
+}
+
+// Order matters unless sorted is set, for operators that emit in hash order
+auto check(const std::string &name, const rows_t &got,
+           std::vector<std::vector<std::string>> expected, bool sorted = false)
+    -> bool {
+  auto actual = fields(got);
+  if (sorted) {
+    std::ranges::sort(actual);
+    std::ranges::sort(expected);
+  }
+  if (actual == expected) {
+    return true;
+  }
+  std::cout << name << ": rows differ\n";
+  std::cout << " expected:\n" << show(expected);
+  std::cout << " got:\n" << show(actual);
+  return false;
+}
+
+auto filter_then_project() -> bool {
+  auto rows = make_rows({{"1", "a", "x"}, {"2", "b", "y"}, {"3", "c", "z"}});
+  rows_t out;
+  collect_sink sink(out);
+  project_op project({2, 0}, sink);
+  filter_op filter(
+      [](const DB_ENGINE::Record &row) { return row.m_fields[0] != "2"; },
+      project);
+  push_rows(rows, filter);
+  filter.finish();
+  return check("filter, project", out, {{"x", "1"}, {"z", "3"}});
+}
+
+auto limit() -> bool {
+  rows_t rows;
+  for (std::size_t i = 0; i < 3 * BATCH_ROWS; ++i) {
+    rows.emplace_back().m_fields = {std::to_string(i)};
+  }
+  rows_t out;
+  collect_sink sink(out);
+  limit_op limit(2, BATCH_ROWS + 1, sink);
+  const bool more = push_rows(rows, limit);
+  limit.finish();
+  const auto first = std::to_string(BATCH_ROWS + 1);
+  const auto second = std::to_string(BATCH_ROWS + 2);
+  if (more) {
+    std::cout << "limit: sources weren't stopped\n";
+    return false;
+  }
+  return check("limit", out, {{first}, {second}});
+}
+
+auto sort() -> bool {
+  auto rows = make_rows(
+      {{"10", "a"}, {"2", "b"}, {"1.5", "c"}, {"2.0", "a"}, {"-3", "d"}});
+  rows_t out;
+  collect_sink sink(out);
+  sort_op sort({{0, false}, {1, true}}, sink);
+  push_rows(rows, sort);
+  sort.finish();
+  return check(
+      "sort", out,
+      {{"-3", "d"}, {"1.5", "c"}, {"2", "b"}, {"2.0", "a"}, {"10", "a"}});
+}
+
+auto sort_strings() -> bool {
+  auto rows = make_rows({{"b"}, {"10"}, {"a"}, {"9"}});
+  rows_t out;
+  collect_sink sink(out);
+  sort_op sort({{0, true}}, sink);
+  push_rows(rows, sort);
+  sort.finish();
+  return check("sort descending", out, {{"b"}, {"a"}, {"10"}, {"9"}});
+}
+
+auto aggregate() -> bool {
+  auto rows = make_rows({{"1", "4"},
+                         {"1.0", "10"},
+                         {"01", "2"},
+                         {"x", "3"},
+                         {"2", "-1"},
+                         {"-0", "5"},
+                         {"0", "7"}});
+  rows_t out;
+  collect_sink sink(out);
+  aggregate_op aggregate({0},
+                         {{aggregate_t::COUNT},
+                          {aggregate_t::SUM, 1},
+                          {aggregate_t::MIN, 1},
+                          {aggregate_t::MAX, 1},
+                          {aggregate_t::AVG, 1}},
+                         sink);
+  push_rows(rows, aggregate);
+  aggregate.finish();
+  // A group keeps the spelling of its first row
+  return check("aggregate", out,
+               {{"1", "3", "16.000000", "2", "10", "5.333333"},
+                {"x", "1", "3.000000", "3", "3", "3.000000"},
+                {"2", "1", "-1.000000", "-1", "-1", "-1.000000"},
+                {"-0", "2", "12.000000", "5", "7", "6.000000"}},
+               true);
+}
+
+auto aggregate_empty() -> bool {
+  rows_t rows;
+  rows_t out;
+  collect_sink sink(out);
+  aggregate_op aggregate({}, {{aggregate_t::COUNT}, {aggregate_t::AVG, 0}},
+                         sink);
+  push_rows(rows, aggregate);
+  aggregate.finish();
+  return check("aggregate no rows", out, {{"0", ""}});
+}
+
+auto hash_join() -> bool {
+  auto build = make_rows({{"1", "one"}, {"2.0", "two"}, {"b", "bee"}});
+  auto probe = make_rows(
+      {{"1.0", "p"}, {"2", "q"}, {"b", "r"}, {"3", "s"}, {"01", "t"}});
+  rows_t out;
+  collect_sink sink(out);
+  hash_join_op join(0, 0, sink);
+  push_rows(build, join.build_side());
+  push_rows(probe, join);
+  join.finish();
+  return check("hash join", out,
+               {{"1.0", "p", "1", "one"},
+                {"2", "q", "2.0", "two"},
+                {"b", "r", "b", "bee"},
+                {"01", "t", "1", "one"}});
+}
+
+// Duplicates across batches, within a batch and from a second source
+auto union_all_batches() -> bool {
+  rows_t first;
+  rows_t second;
+  for (std::size_t i = 0; i < 2 * BATCH_ROWS; ++i) {
+    first.emplace_back().m_fields = {std::to_string(i % BATCH_ROWS), "x"};
+    second.emplace_back().m_fields = {std::to_string(i), "x"};
+  }
+  rows_t out;
+  std::vector<std::size_t> slots;
+  union_op op(out, slots);
+  push_rows(first, op);
+  push_rows(second, op);
+  op.finish();
+  std::vector<std::vector<std::string>> expected;
+  for (std::size_t i = 0; i < 2 * BATCH_ROWS; ++i) {
+    expected.push_back({std::to_string(i), "x"});
+  }
+  return check("union", out, expected);
+}
+
+// A by value predicate runs once per distinct value of a morsel and picks
+// the same rows as running it on every row
+auto filter_by_value() -> bool {
+  constexpr std::size_t NAMES = 3;
+  rows_t rows;
+  std::vector<std::vector<std::string>> expected;
+  for (std::size_t i = 0; i < 2 * MORSEL_ROWS + 1; ++i) {
+    const auto id = std::to_string(i);
+    const auto name = "'n" + std::to_string(i % NAMES) + "'";
+    rows.emplace_back().m_fields = {id, name, std::to_string(i % 5)};
+    if (name == "'n1'" && i % 5 != 0) {
+      expected.push_back({id});
+    }
+  }
+  std::atomic<std::size_t> calls{0};
+  const std::vector<value_predicate_t> by_value{
+      {1, [&](const DB_ENGINE::Record &row) {
+         ++calls;
+         return row.m_fields[1] == "'n1'";
+       }}};
+  const std::vector<std::size_t> columns{0};
+  const auto out = filter_project(
+      std::move(rows),
+      [](const DB_ENGINE::Record &row) { return row.m_fields[2] != "0"; },
+      columns, by_value);
+  if (calls > 3 * NAMES) {
+    std::cout << "filter by value: predicate ran " << calls
+              << " times over 3 morsels of " << NAMES << " values\n";
+    return false;
+  }
+  return check("filter by value", out, expected);
+}
+
+} // namespace
+
+int main() {
+  std::size_t failed = 0;
+  const auto checks = {filter_then_project, limit,
+                       sort,                sort_strings,
+                       aggregate,           aggregate_empty,
+                       hash_join,           union_all_batches,
+                       filter_by_value};
+  for (const auto &run : checks) {
+    failed += run() ? 0 : 1;
+  }
+  std::cout << checks.size() - failed << "/" << checks.size()
+            << " operator checks pass\n";
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
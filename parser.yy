@@ -66,7 +66,7 @@
 %define api.value.type variant
 %define parse.assert
 
-%token ENDL SEP INSERT UPDATE DELETE SELECT CREATE FROM INTO SET VALUES WHERE AND OR EQUAL TABLE INDEX COLUMN PI PD PK ALL DROP ON ISAM SEQ AVL BETWEEN
+%token ENDL SEP INSERT UPDATE DELETE SELECT CREATE FROM INTO SET VALUES WHERE AND OR EQUAL TABLE INDEX COLUMN PI PD PK ALL DROP ON ISAM SEQ AVL BETWEEN EXPLAIN ANALYZE SHOW METRICS ARROW COPY TO CONCURRENTLY
 %token INT DOUBLE CHAR BOOL
 %token GE G LE L
 %token <std::string> ID
@@ -94,9 +94,9 @@
 %%
 
 PROGRAM:            /*  */
-                    | SENTENCE ENDL PROGRAM;
+                    | SENTENCE ENDL {dr.end_statement();} PROGRAM;
 
-SENTENCE:           INSERT_TYPE | DELETE_TYPE | UPDATE_TYPE | CREATE_TYPE | SELECT_TYPE | DROP_TYPE;
+SENTENCE:           INSERT_TYPE | DELETE_TYPE | UPDATE_TYPE | CREATE_TYPE | SELECT_TYPE | DROP_TYPE | EXPLAIN_TYPE | SHOW_TYPE | COPY_TYPE;
 
 INPLACE_VALUE:      STRING      {$$ = $1;} 
                     | NUM       {$$ = std::to_string($1);} 
@@ -110,12 +110,17 @@ INSERT_TYPE:        INSERT INTO ID {dr.check_table_name($3);} VALUES PI PARAMS P
 DELETE_TYPE:        DELETE FROM ID {dr.check_table_name($3);} CONDITIONALS {dr.remove($3, $5);};
 UPDATE_TYPE:        UPDATE ID SET SET_LIST CONDITIONALS;
 DROP_TYPE  :        DROP TABLE ID {dr.check_table_name($3); dr.drop_table($3);}
-CREATE_TYPE:        CREATE TABLE ID PI CREATE_LIST PD {dr.create_table($3, $5);} | CREATE INDEX INDEX_TYPES ON ID PI ID PD {dr.create_index($5, $7, $3);};
-SELECT_TYPE:        SELECT COLUMNS FROM ID {dr.check_table_name($4);} CONDITIONALS {dr.select($4, $2, $6);} 
-                    | SELECT ALL FROM ID {dr.check_table_name($4);} CONDITIONALS {dr.select($4, dr.get_engine().get_table_attributes($4), $6);}
+CREATE_TYPE:        CREATE TABLE ID PI CREATE_LIST PD {dr.create_table($3, $5);} | CREATE INDEX INDEX_TYPES ON ID PI ID PD {dr.create_index($5, $7, $3);} | CREATE INDEX CONCURRENTLY INDEX_TYPES ON ID PI ID PD {dr.create_index_concurrently($6, $8, $4);};
+SELECT_TYPE:        SELECT COLUMNS FROM ID {dr.check_table_name($4);} CONDITIONALS SELECT_TARGET {dr.select($4, $2, $6);} 
+                    | SELECT ALL FROM ID {dr.check_table_name($4);} CONDITIONALS SELECT_TARGET {dr.select($4, dr.get_engine().get_table_attributes($4), $6);}
                     /* | SELECT ALL FROM ID WHERE ID BETWEEN PI INPLACE_VALUE SEP INPLACE_VALUE PD {dr.select_between($4, dr.get_engine().get_table_attributes($4), $6, $9, $11);}
                     | SELECT COLUMNS FROM ID WHERE ID BETWEEN PI INPLACE_VALUE SEP INPLACE_VALUE PD {dr.select_between($4, $2, $6, $9, $11);};
  */
+EXPLAIN_TYPE:       EXPLAIN ANALYZE {dr.explain_next();} SELECT_TYPE;
+SHOW_TYPE:          SHOW METRICS {dr.show_metrics();};
+COPY_TYPE:          COPY ID {dr.check_table_name($2);} TO STRING CONDITIONALS {dr.copy_to($2, $5, $6);};
+SELECT_TARGET:      /*  */ {} | INTO ARROW STRING {dr.export_next($3);};
+
 /* TYPES */
 TYPE:               INT {$$ = Type(Type::INT);}| DOUBLE {$$ = Type(Type::FLOAT);} | CHAR {$$ = Type(Type::VARCHAR, 1);} | CHAR PI NUM PD {$$ = Type(Type::VARCHAR, $3);}| BOOL {$$ = Type(Type::BOOL);}
 INDEX_TYPES:        ISAM {$$ = DB_ENGINE::DBEngine::Index_t::ISAM;} | SEQ {$$ = DB_ENGINE::DBEngine::Index_t::SEQUENTIAL;} | AVL {$$ = DB_ENGINE::DBEngine::Index_t::AVL;};
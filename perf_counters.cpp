@@ -0,0 +1,96 @@
+#include <spdlog/spdlog.h>
+
+#include "perf_counters.hpp"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct event_t {
+  uint32_t type;
+  uint64_t config;
+};
+
+// Same order as counter_t. The generic cache miss event counts the last
+// level cache on every PMU the kernel maps it for.
+constexpr std::array<event_t, COUNTERS> EVENTS{{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+}};
+
+auto open_event(const event_t &event, int group) -> int {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.disabled = group == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+} // namespace
+
+perf_counters::perf_counters() {
+  for (std::size_t i = 0; i < COUNTERS; ++i) {
+    const int fd = open_event(EVENTS[i], m_leader);
+    if (fd == -1) {
+      spdlog::warn("perf counter {} unavailable: {}", COUNTER_NAMES[i],
+                   std::strerror(errno));
+      continue;
+    }
+    if (m_leader == -1) {
+      m_leader = fd;
+    }
+    m_fds[m_opened] = fd;
+    m_slots[m_opened] = i;
+    ++m_opened;
+  }
+  if (available()) {
+    ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+perf_counters::~perf_counters() {
+  for (std::size_t i = 0; i < m_opened; ++i) {
+    close(m_fds[i]);
+  }
+}
+
+auto perf_counters::read() const -> counter_values_t {
+  counter_values_t values{};
+  if (!available()) {
+    return values;
+  }
+  // PERF_FORMAT_GROUP layout: the member count, then one value per member
+  std::array<uint64_t, COUNTERS + 1> buffer{};
+  if (::read(m_leader, buffer.data(), sizeof(buffer)) <= 0) {
+    return values;
+  }
+  for (std::size_t i = 0; i < m_opened && i < buffer[0]; ++i) {
+    values[m_slots[i]] = buffer[i + 1];
+  }
+  return values;
+}
+
+#else
+
+perf_counters::perf_counters() {
+  spdlog::warn("perf counters are only available on Linux");
+}
+
+perf_counters::~perf_counters() = default;
+
+auto perf_counters::read() const -> counter_values_t { return {}; }
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP 1
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class counter_t {
+  CYCLES,
+  INSTRUCTIONS,
+  LLC_MISSES,
+  BRANCH_MISSES,
+  PAGE_FAULTS
+};
+
+constexpr std::size_t COUNTERS = 5;
+constexpr std::array<std::string_view, COUNTERS> COUNTER_NAMES{
+    "cycles", "instructions", "llc_misses", "branch_misses", "page_faults"};
+
+using counter_values_t = std::array<uint64_t, COUNTERS>;
+
+// Hardware counters of the calling thread, opened as one perf_event_open
+// group so a single read() returns all of them. Events the kernel refuses
+// (no PMU in a VM, perf_event_paranoid) are left out and read as 0; off
+// Linux nothing is opened at all.
+class perf_counters {
+public:
+  perf_counters();
+  ~perf_counters();
+
+  perf_counters(const perf_counters &) = delete;
+  auto operator=(const perf_counters &) -> perf_counters & = delete;
+
+  [[nodiscard]] auto available() const -> bool { return m_leader != -1; }
+
+  // Running totals since the group was opened
+  [[nodiscard]] auto read() const -> counter_values_t;
+
+private:
+  int m_leader = -1;
+  std::array<int, COUNTERS> m_fds{};
+  // Group members in the order the kernel reports them
+  std::array<std::size_t, COUNTERS> m_slots{};
+  std::size_t m_opened = 0;
+};
+
+#endif // PERF_COUNTERS_HPP
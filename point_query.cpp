@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+
+#include "fingerprint.hpp"
+#include "point_query.hpp"
+
+namespace {
+
+// Words the lexer turns into something other than a plain ID. "primary" is
+// here because it may be the start of "primary key".
+constexpr std::array<std::string_view, 34> RESERVED{
+    "insert",  "update",  "delete", "select", "create",  "drop",
+    "from",    "into",    "set",    "values", "where",   "and",
+    "or",      "between", "table",  "index",  "column",  "seq",
+    "avl",     "isam",    "int",    "double", "char",    "bool",
+    "on",      "explain", "analyze", "show",  "metrics", "arrow",
+    "copy",    "to",      "concurrently", "primary"};
+
+constexpr auto is_space(char c) -> bool {
+  return c == ' ' || c == '\t' || c == '\n';
+}
+constexpr auto is_letter(char c) -> bool {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+constexpr auto is_digit(char c) -> bool { return c >= '0' && c <= '9'; }
+constexpr auto is_ident(char c) -> bool {
+  return is_letter(c) || is_digit(c) || c == '_';
+}
+
+auto iequals(std::string_view word, std::string_view lower) -> bool {
+  return word.size() == lower.size() &&
+         std::ranges::equal(word, lower, [](char a, char b) {
+           return (a | 0x20) == b;
+         });
+}
+
+// Tokenizes just enough SQL for the point query shape, every method skips
+// the leading whitespace and leaves the position untouched on mismatch
+class cursor {
+public:
+  explicit cursor(std::string_view text) : m_text(text) {}
+
+  void skip_spaces() {
+    while (m_pos < m_text.size() && is_space(m_text[m_pos])) {
+      ++m_pos;
+    }
+  }
+
+  auto at_end() -> bool {
+    skip_spaces();
+    return m_pos == m_text.size();
+  }
+
+  auto consume(char c) -> bool {
+    skip_spaces();
+    if (m_pos < m_text.size() && m_text[m_pos] == c) {
+      ++m_pos;
+      return true;
+    }
+    return false;
+  }
+
+  auto keyword(std::string_view lower) -> bool {
+    std::string_view word;
+    const std::size_t start = m_pos;
+    if (word_at(word) && iequals(word, lower)) {
+      return true;
+    }
+    m_pos = start;
+    return false;
+  }
+
+  auto identifier(std::string_view &out) -> bool {
+    const std::size_t start = m_pos;
+    if (word_at(out) && std::ranges::none_of(RESERVED, [&](auto reserved) {
+          return iequals(out, reserved);
+        })) {
+      return true;
+    }
+    m_pos = start;
+    return false;
+  }
+
+  auto literal(std::string &out) -> bool {
+    skip_spaces();
+    if (m_pos == m_text.size()) {
+      return false;
+    }
+    const char *begin = m_text.data() + m_pos;
+    const char *end = m_text.data() + m_text.size();
+
+    if (*begin == '\'') {
+      const auto closing = m_text.find('\'', m_pos + 1);
+      if (closing == std::string_view::npos) {
+        return false;
+      }
+      out.assign(m_text.substr(m_pos, closing + 1 - m_pos));
+      m_pos = closing + 1;
+      return true;
+    }
+
+    const char *last = begin;
+    while (last < end && is_digit(*last)) {
+      ++last;
+    }
+    const bool floating = last < end && *last == '.';
+    if (floating) {
+      ++last;
+      while (last < end && is_digit(*last)) {
+        ++last;
+      }
+    }
+    if (last == begin || (floating && last == begin + 1)) {
+      return false;
+    }
+
+    // Spell the value the way the grammar's std::to_string does
+    if (floating) {
+      double value = 0;
+      if (std::from_chars(begin, last, value).ptr != last) {
+        return false;
+      }
+      out = std::to_string(value);
+    } else {
+      int value = 0;
+      if (std::from_chars(begin, last, value).ptr != last) {
+        return false;
+      }
+      out = std::to_string(value);
+    }
+    m_pos += static_cast<std::size_t>(last - begin);
+    return true;
+  }
+
+private:
+  auto word_at(std::string_view &out) -> bool {
+    skip_spaces();
+    if (m_pos == m_text.size() || !is_letter(m_text[m_pos])) {
+      return false;
+    }
+    std::size_t last = m_pos + 1;
+    while (last < m_text.size() && is_ident(m_text[last])) {
+      ++last;
+    }
+    out = m_text.substr(m_pos, last - m_pos);
+    m_pos = last;
+    return true;
+  }
+
+  std::string_view m_text;
+  std::size_t m_pos = 0;
+};
+
+} // namespace
+
+auto match_point_query(std::string_view query, point_query_t &out) -> bool {
+  using token = yy::parser::token;
+  out.clear();
+  cursor cur(query);
+
+  if (!cur.keyword("select")) {
+    return false;
+  }
+  if (!cur.consume('*')) {
+    do {
+      std::string_view column;
+      if (!cur.identifier(column)) {
+        return false;
+      }
+      out.columns.push_back(column);
+    } while (cur.consume(','));
+  }
+
+  if (!(cur.keyword("from") && cur.identifier(out.table) &&
+        cur.keyword("where") && cur.identifier(out.key_column) &&
+        cur.consume('=') && cur.literal(out.key_value) && cur.consume(';') &&
+        cur.at_end())) {
+    return false;
+  }
+
+  query_fingerprint fingerprint;
+  fingerprint.add(token::SELECT, {});
+  if (out.columns.empty()) {
+    fingerprint.add(token::ALL, {});
+  }
+  for (std::size_t i = 0; i < out.columns.size(); ++i) {
+    if (i != 0) {
+      fingerprint.add(token::SEP, {});
+    }
+    fingerprint.add(token::ID, out.columns[i]);
+  }
+  fingerprint.add(token::FROM, {});
+  fingerprint.add(token::ID, out.table);
+  fingerprint.add(token::WHERE, {});
+  fingerprint.add(token::ID, out.key_column);
+  fingerprint.add(token::EQUAL, {});
+  fingerprint.add(token::STRING, {});
+  fingerprint.add(token::ENDL, {});
+  out.fingerprint = fingerprint.last();
+  return true;
+}
@@ -0,0 +1,29 @@
+#ifndef POINT_QUERY_HPP
+#define POINT_QUERY_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A single `SELECT <cols> FROM t WHERE col = <literal>;` statement, as
+// recognized without going through the bison parser
+struct point_query_t {
+  std::string_view table;
+  std::vector<std::string_view> columns; // Empty for SELECT *
+  std::string_view key_column;
+  std::string key_value; // Same spelling the grammar's INPLACE_VALUE produces
+  uint64_t fingerprint = 0; // As the scanner would have computed it
+
+  void clear() {
+    columns.clear();
+    key_value.clear();
+  }
+};
+
+// Matches the whole query against the point query shape. Returns false for
+// anything else (including what would be a syntax error) so the caller can
+// fall back to the full parser.
+auto match_point_query(std::string_view query, point_query_t &out) -> bool;
+
+#endif // POINT_QUERY_HPP
@@ -0,0 +1,62 @@
+#include <spdlog/spdlog.h>
+
+#include "query_stats.hpp"
+
+auto explain_analyze(const statement_stats_t &stats) -> std::string {
+  using std::chrono::duration;
+
+  std::string text;
+  auto out = std::back_inserter(text);
+
+  for (const auto &step : stats.plan) {
+    if (step.index_column.empty()) {
+      fmt::format_to(out, "{} on {} (rows={})\n", step.access, step.table,
+                     step.rows);
+    } else if (step.probes == 1) {
+      fmt::format_to(out, "{} on {} using {} (rows={})\n", step.access,
+                     step.table, step.index_column, step.rows);
+    } else {
+      fmt::format_to(out, "{} on {} using {} (rows={}, probes={})\n",
+                     step.access, step.table, step.index_column, step.rows,
+                     step.probes);
+    }
+  }
+  fmt::format_to(out, "Rows examined: {}, returned: {}\n", stats.rows_examined,
+                 stats.rows_returned);
+  fmt::format_to(out, "Total time: {:.3f} ms\n",
+                 duration<double, std::milli>(stats.total).count());
+
+  fmt::format_to(out, "{:<8} {:>12}", "phase", "time_ms");
+  if (stats.has_counters) {
+    for (const auto &name : COUNTER_NAMES) {
+      fmt::format_to(out, " {:>14}", name);
+    }
+  }
+  if (ALLOC_PROFILING) {
+    fmt::format_to(out, " {:>10} {:>12} {:>12}", "allocs", "alloc_bytes",
+                   "peak_bytes");
+  }
+  text += '\n';
+  for (std::size_t phase = 0; phase < PHASES; ++phase) {
+    fmt::format_to(
+        out, "{:<8} {:>12.3f}", PHASE_NAMES[phase],
+        duration<double, std::milli>(stats.phase_times[phase]).count());
+    if (stats.has_counters) {
+      for (const auto value : stats.phase_counters[phase]) {
+        fmt::format_to(out, " {:>14}", value);
+      }
+    }
+    if (ALLOC_PROFILING) {
+      const auto &allocs = stats.phase_allocs[phase];
+      fmt::format_to(out, " {:>10} {:>12} {:>12}", allocs.allocations,
+                     allocs.bytes, allocs.peak_bytes);
+    }
+    text += '\n';
+  }
+  if (ALLOC_PROFILING) {
+    fmt::format_to(out, "Allocations: {}, bytes: {}, peak live bytes: {}\n",
+                   stats.allocs.allocations, stats.allocs.bytes,
+                   stats.allocs.peak_bytes);
+  }
+  return text;
+}
@@ -0,0 +1,140 @@
+#ifndef QUERY_STATS_HPP
+#define QUERY_STATS_HPP 1
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "alloc_profile.hpp"
+#include "perf_counters.hpp"
+#include "trace.hpp"
+
+// Where a statement's time goes. PARSE is whatever isn't attributed to the
+// other phases: lexing, grammar actions and catalog checks.
+enum class phase_t { PARSE, PLAN, EXECUTE, OUTPUT };
+
+constexpr std::size_t PHASES = 4;
+constexpr std::array<std::string_view, PHASES> PHASE_NAMES{
+    "parse", "plan", "execute", "output"};
+
+// How one OR branch of a SELECT was answered
+struct plan_step_t {
+  std::string table;
+  std::string access;       // "load", "search" or "range_search"
+  std::string index_column; // Empty on a full scan
+  std::size_t rows = 0;     // As returned by the engine, before merging
+  std::size_t probes = 0;   // Index searches, one per key fetched by key
+};
+
+struct statement_stats_t {
+  std::string_view type = "other"; // "select", "insert", ... for metrics
+  std::string table;               // Empty when not about a single table
+  std::chrono::nanoseconds total{0};
+  std::array<std::chrono::nanoseconds, PHASES> phase_times{};
+  bool has_counters = false; // Only when the session enabled perf counters
+  std::array<counter_values_t, PHASES> phase_counters{};
+  alloc_stats_t allocs; // Zero unless built with SQLPARSER_ALLOC_PROFILE
+  std::array<alloc_stats_t, PHASES> phase_allocs{};
+  std::vector<plan_step_t> plan;
+  std::size_t rows_examined = 0;
+  std::size_t rows_returned = 0;
+  std::size_t bytes_written = 0;
+
+  void clear() {
+    type = "other";
+    table.clear();
+    total = {};
+    phase_times.fill({});
+    has_counters = false;
+    phase_counters.fill({});
+    allocs = {};
+    phase_allocs.fill({});
+    plan.clear();
+    rows_examined = 0;
+    rows_returned = 0;
+    bytes_written = 0;
+  }
+};
+
+// Human readable plan, timings and counters for EXPLAIN ANALYZE
+auto explain_analyze(const statement_stats_t &stats) -> std::string;
+
+// Charges elapsed time, and counter deltas when given counters, to the
+// current phase of a statement. enter() closes the running phase and opens
+// the next one.
+class phase_timer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  phase_timer(statement_stats_t &stats, phase_t phase,
+              const perf_counters *counters = nullptr)
+      : m_stats(stats), m_phase(phase), m_counters(counters),
+        m_start(clock::now()) {
+    if (m_counters != nullptr) {
+      m_counters_start = m_counters->read();
+    }
+    start_allocs();
+  }
+
+  ~phase_timer() { stop(); }
+
+  phase_timer(const phase_timer &) = delete;
+  auto operator=(const phase_timer &) -> phase_timer & = delete;
+
+  void enter(phase_t phase) {
+    stop();
+    m_phase = phase;
+    start_allocs();
+  }
+
+private:
+  void start_allocs() {
+    if constexpr (ALLOC_PROFILING) {
+      alloc_mark_phase();
+      m_allocs_start = alloc_counters();
+    }
+  }
+
+  void stop() {
+    const auto phase = static_cast<std::size_t>(m_phase);
+    const auto now = clock::now();
+    m_stats.phase_times[phase] += now - m_start;
+    if (tracer::enabled()) {
+      tracer::instance().record(
+          {PHASE_NAMES[phase].data(), "phase", m_start, now - m_start, {}});
+    }
+    m_start = now;
+
+    if (m_counters != nullptr) {
+      const auto counters = m_counters->read();
+      for (std::size_t i = 0; i < COUNTERS; ++i) {
+        m_stats.phase_counters[phase][i] += counters[i] - m_counters_start[i];
+      }
+      m_counters_start = counters;
+    }
+
+    if constexpr (ALLOC_PROFILING) {
+      const auto &allocs = alloc_counters();
+      auto &phase_allocs = m_stats.phase_allocs[phase];
+      phase_allocs.allocations +=
+          allocs.allocations - m_allocs_start.allocations;
+      phase_allocs.bytes += allocs.bytes - m_allocs_start.bytes;
+      phase_allocs.peak_bytes = std::max(
+          phase_allocs.peak_bytes,
+          static_cast<uint64_t>(allocs.phase_peak - m_allocs_start.live));
+    }
+  }
+
+  statement_stats_t &m_stats;
+  phase_t m_phase;
+  const perf_counters *m_counters;
+  clock::time_point m_start;
+  counter_values_t m_counters_start{};
+  alloc_counters_t m_allocs_start{};
+};
+
+#endif // QUERY_STATS_HPP
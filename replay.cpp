@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "SqlParser.hpp"
+#include "histogram.hpp"
+#include "metrics.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
+#include "workload_capture.hpp"
+
+// Re-issues a workload recorded with SqlParser::set_workload_capture and
+// reports the latency distribution, to compare builds on the same traffic
+namespace {
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+struct options_t {
+  std::string capture;
+  double speed = 1; // 0 replays as fast as possible
+  std::size_t threads = 1;
+  std::string dir;         // Database copy to run against
+  std::string copy_from;   // Database copied to a scratch directory first
+  std::string metrics;     // Prometheus textfile rewritten every second
+  std::string trace;       // Chrome trace of the whole replay
+  std::size_t workers = 0; // Task scheduler threads, 0 for the default
+};
+
+void usage() {
+  std::cout << "usage: sql_replay <capture> [options]\n";
+  std::cout << "  -s <speed>    1 keeps the original timing, 2 is twice as "
+               "fast, 0 doesn't wait\n";
+  std::cout << "  -t <threads>  sessions are spread over this many threads\n";
+  std::cout << "  -C <dir>      run against the database copy in dir\n";
+  std::cout << "  -c <dir>      copy the database in dir to a scratch "
+               "directory and run there\n";
+  std::cout << "one of -C or -c is required, replayed writes change the "
+               "database\n";
+  std::cout << "  -m <file>     dump metrics to file every second\n";
+  std::cout << "  -T <file>     write a Chrome trace of the replay to file\n";
+  std::cout << "  -w <workers>  task scheduler threads for parallel work\n";
+}
+
+auto parse_options(const int argc, const char **argv, options_t &options)
+    -> bool {
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (std::strncmp(argv[i], "-s", 2) == 0 && has_value) {
+      options.speed = std::strtod(argv[++i], nullptr);
+    } else if (std::strncmp(argv[i], "-t", 2) == 0 && has_value) {
+      options.threads = std::max(1UL, std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strncmp(argv[i], "-C", 2) == 0 && has_value) {
+      options.dir = argv[++i];
+    } else if (std::strncmp(argv[i], "-c", 2) == 0 && has_value) {
+      options.copy_from = argv[++i];
+    } else if (std::strncmp(argv[i], "-m", 2) == 0 && has_value) {
+      options.metrics = argv[++i];
+    } else if (std::strncmp(argv[i], "-T", 2) == 0 && has_value) {
+      options.trace = argv[++i];
+    } else if (std::strncmp(argv[i], "-w", 2) == 0 && has_value) {
+      options.workers = std::strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] != '-' && options.capture.empty()) {
+      options.capture = argv[i];
+    } else {
+      return false;
+    }
+  }
+  // Never replay against whatever the working directory holds
+  return !options.capture.empty() && options.speed >= 0 &&
+         options.dir.empty() != options.copy_from.empty();
+}
+
+// A fresh directory under the system temp directory holding a copy of dir
+auto scratch_copy(const std::string &dir) -> std::filesystem::path {
+  namespace fs = std::filesystem;
+  const auto stamp = steady_clock::now().time_since_epoch().count();
+  auto scratch =
+      fs::temp_directory_path() / ("sql_replay-" + std::to_string(stamp));
+  fs::create_directories(scratch);
+  fs::copy(dir, scratch, fs::copy_options::recursive);
+  return scratch;
+}
+
+void print_distribution(const char *name, const histogram &values) {
+  constexpr double NS_PER_US = 1000;
+  auto us = [&](uint64_t ns) { return static_cast<double>(ns) / NS_PER_US; };
+  std::cout << name << " (us): p50 " << us(values.percentile(0.5))
+            << "  p90 " << us(values.percentile(0.9)) << "  p99 "
+            << us(values.percentile(0.99)) << "  p99.9 "
+            << us(values.percentile(0.999)) << "  max " << us(values.max())
+            << '\n';
+}
+
+void print_counts(const char *name, const histogram &values) {
+  std::cout << name << " per statement: p50 " << values.percentile(0.5)
+            << "  p99 " << values.percentile(0.99) << "  max " << values.max()
+            << "  total " << values.sum() << '\n';
+}
+
+} // namespace
+
+int main(const int argc, const char **argv) {
+  options_t options;
+  if (!parse_options(argc, argv, options)) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  spdlog::set_level(spdlog::level::warn);
+  if (options.workers != 0) {
+    task_scheduler::set_workers(options.workers);
+  }
+
+  auto statements = read_workload(options.capture);
+  if (statements.empty()) {
+    std::cout << "Empty workload\n";
+    return EXIT_SUCCESS;
+  }
+  std::ranges::stable_sort(statements, {},
+                           &captured_statement_t::timestamp_ns);
+  std::filesystem::path scratch;
+  if (!options.copy_from.empty()) {
+    scratch = scratch_copy(options.copy_from);
+    options.dir = scratch.string();
+    std::cout << "replaying against a copy in " << options.dir << '\n';
+  }
+  // Output paths are relative to where the replay was started, not to the
+  // data directory, and stay outside a scratch copy that is removed
+  for (auto *path : {&options.metrics, &options.trace}) {
+    if (!path->empty()) {
+      *path = std::filesystem::absolute(*path).string();
+    }
+  }
+  std::filesystem::current_path(options.dir);
+  if (!options.metrics.empty()) {
+    metrics_registry::instance().start_dump(options.metrics,
+                                            std::chrono::seconds{1});
+  }
+  if (!options.trace.empty()) {
+    tracer::instance().start();
+  }
+
+  // A session's statements must run in order, so it stays on one thread
+  std::unordered_map<uint64_t, std::size_t> session_thread;
+  std::vector<std::vector<const captured_statement_t *>> work(options.threads);
+  for (const auto &statement : statements) {
+    auto [it, inserted] = session_thread.try_emplace(
+        statement.session_id, session_thread.size() % options.threads);
+    work[it->second].push_back(&statement);
+  }
+
+  auto latency = std::make_unique<histogram>();
+  auto lag = std::make_unique<histogram>();
+  auto allocations = std::make_unique<histogram>();
+  auto alloc_bytes = std::make_unique<histogram>();
+  std::atomic<std::size_t> errors{0};
+  const uint64_t first_ns = statements.front().timestamp_ns;
+  const auto start = steady_clock::now();
+
+  std::vector<std::thread> threads;
+  threads.reserve(options.threads);
+  for (const auto &items : work) {
+    threads.emplace_back([&, &items = items] {
+      std::unordered_map<uint64_t, std::unique_ptr<SqlParser>> sessions;
+      for (const auto *statement : items) {
+        if (options.speed > 0) {
+          const auto due =
+              start + nanoseconds(static_cast<int64_t>(
+                          static_cast<double>(statement->timestamp_ns -
+                                              first_ns) /
+                          options.speed));
+          std::this_thread::sleep_until(due);
+          lag->record(static_cast<uint64_t>(
+              std::max(nanoseconds{0}, steady_clock::now() - due).count()));
+        }
+
+        auto &session = sessions[statement->session_id];
+        if (!session) {
+          session = std::make_unique<SqlParser>();
+        }
+        const auto begin = steady_clock::now();
+        try {
+          session->clear();
+          const auto &stats = session->parse_query(statement->text).stats;
+          allocations->record(stats.allocs.allocations);
+          alloc_bytes->record(stats.allocs.bytes);
+        } catch (const std::exception &) {
+          ++errors;
+        }
+        latency->record(
+            static_cast<uint64_t>((steady_clock::now() - begin).count()));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (!options.trace.empty()) {
+    tracer::instance().stop();
+    tracer::instance().write(options.trace);
+  }
+
+  const std::chrono::duration<double> elapsed = steady_clock::now() - start;
+  std::cout << "statements: " << statements.size()
+            << "  sessions: " << session_thread.size()
+            << "  threads: " << options.threads << "  errors: " << errors
+            << '\n';
+  std::cout << "elapsed: " << elapsed.count() << " s  throughput: "
+            << static_cast<double>(statements.size()) / elapsed.count()
+            << " statements/s\n";
+  print_distribution("latency", *latency);
+  if (const auto scheduler = task_scheduler::stats(); scheduler.workers != 0) {
+    std::cout << "scheduler: " << scheduler.workers << " workers  tasks "
+              << scheduler.tasks << "  steals " << scheduler.steals
+              << "  utilization " << scheduler.utilization() << '\n';
+  }
+  if (ALLOC_PROFILING) {
+    print_counts("allocations", *allocations);
+    print_counts("allocated bytes", *alloc_bytes);
+  }
+  if (options.speed > 0) {
+    print_distribution("start lag", *lag);
+  }
+  metrics_registry::instance().stop_dump();
+  if (!scratch.empty()) {
+    std::filesystem::current_path(scratch.parent_path());
+    std::filesystem::remove_all(scratch);
+  }
+  return EXIT_SUCCESS;
+}
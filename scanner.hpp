@@ -1,29 +1,20 @@
 #ifndef SCANNER_HPP
 #define SCANNER_HPP 1
 
-#if !defined(yyFlexLexerOnce)
-#include <FlexLexer.h>
+// The parser is built against whichever scanner the build selected, both
+// are always available to sql_lexer_check
+#ifdef SQLPARSER_SIMD_LEXER
+#include "simd_scanner.hpp"
+using scanner_base = simd_scanner;
+#else
+#include "flex_scanner.hpp"
+using scanner_base = flex_scanner;
 #endif
 
-#include "location.hh"
-#include "parser.tab.hh"
-
-class scanner : public yyFlexLexer {
+// A class rather than an alias, parser.yy forward declares it
+class scanner : public scanner_base {
 public:
-  scanner(std::istream *in) : yyFlexLexer(in) {
-    loc = new yy::parser::location_type();
-  }
-
-  ~scanner() override { delete loc; }
-
-  using FlexLexer::yylex;
-
-  virtual int yylex(yy::parser::semantic_type *const lval,
-                    yy::parser::location_type *location);
-
-private:
-  yy::parser::semantic_type *yylval = nullptr;
-  yy::parser::location_type *loc = nullptr;
+  using scanner_base::scanner_base;
 };
 
 #endif // SCANNER_HPP
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <spdlog/spdlog.h>
+#include <string>
+
+#include "scheduler.hpp"
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+constexpr std::size_t NOT_A_WORKER = std::numeric_limits<std::size_t>::max();
+thread_local std::size_t current_worker = NOT_A_WORKER;
+
+// Kept outside the instance so stats() can be read before it exists
+std::atomic<std::size_t> requested_workers{0};
+std::atomic<std::size_t> started_workers{0};
+std::atomic<int64_t> start_ns{0};
+std::atomic<uint64_t> tasks_run{0};
+std::atomic<uint64_t> tasks_stolen{0};
+std::atomic<int64_t> busy_ns{0};
+
+auto default_workers() -> std::size_t {
+  if (const auto requested = requested_workers.load(); requested != 0) {
+    return requested;
+  }
+  if (const char *env = std::getenv("SQLPARSER_WORKERS"); env != nullptr) {
+    const auto workers = std::strtoul(env, nullptr, 10);
+    if (workers != 0) {
+      return workers;
+    }
+    spdlog::warn("Ignoring SQLPARSER_WORKERS={}", env);
+  }
+  return std::max(1U, std::thread::hardware_concurrency());
+}
+
+} // namespace
+
+auto task_scheduler::instance() -> task_scheduler & {
+  static task_scheduler scheduler(default_workers());
+  return scheduler;
+}
+
+void task_scheduler::set_workers(std::size_t workers) {
+  requested_workers = workers;
+}
+
+auto task_scheduler::stats() -> scheduler_stats_t {
+  scheduler_stats_t stats;
+  stats.workers = started_workers.load(std::memory_order_relaxed);
+  if (stats.workers == 0) {
+    return stats;
+  }
+  stats.tasks = tasks_run.load(std::memory_order_relaxed);
+  stats.steals = tasks_stolen.load(std::memory_order_relaxed);
+  stats.busy = std::chrono::nanoseconds{busy_ns.load()};
+  stats.uptime = clock::now().time_since_epoch() -
+                 std::chrono::nanoseconds{start_ns.load()};
+  return stats;
+}
+
+task_scheduler::task_scheduler(std::size_t workers) {
+  start_ns = clock::now().time_since_epoch().count();
+  m_workers.reserve(workers);
+  for (std::size_t i = 0; i < workers; ++i) {
+    m_workers.push_back(std::make_unique<worker_t>());
+  }
+  for (std::size_t i = 0; i < workers; ++i) {
+    m_workers[i]->thread = std::thread(&task_scheduler::run, this, i);
+  }
+  started_workers = workers;
+}
+
+task_scheduler::~task_scheduler() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto &worker : m_workers) {
+    worker->thread.join();
+  }
+}
+
+void task_scheduler::submit(task_t task) {
+  const std::size_t index = current_worker != NOT_A_WORKER
+                                ? current_worker
+                                : m_next++ % m_workers.size();
+  {
+    // Counted before the task is visible, so a pop can't take it first and
+    // wrap the count. Under the lock so a worker about to sleep can't miss
+    // it.
+    std::lock_guard lock(m_mutex);
+    ++m_queued;
+  }
+  {
+    auto &worker = *m_workers[index];
+    std::lock_guard lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  m_wake.notify_one();
+}
+
+auto task_scheduler::run_one() -> bool {
+  task_t task;
+  if (!pop(current_worker, task)) {
+    return false;
+  }
+  execute(task);
+  return true;
+}
+
+auto task_scheduler::pop(std::size_t index, task_t &task) -> bool {
+  if (m_queued == 0) {
+    return false;
+  }
+  if (index != NOT_A_WORKER) {
+    auto &own = *m_workers[index];
+    std::lock_guard lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      --m_queued;
+      return true;
+    }
+  }
+
+  // Oldest first from the others, those are the largest pieces of work left
+  const std::size_t first = index != NOT_A_WORKER ? index + 1 : m_next.load();
+  for (std::size_t i = 0; i < m_workers.size(); ++i) {
+    const std::size_t victim = (first + i) % m_workers.size();
+    if (victim == index) {
+      continue;
+    }
+    auto &other = *m_workers[victim];
+    std::lock_guard lock(other.mutex);
+    if (!other.tasks.empty()) {
+      task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      --m_queued;
+      tasks_stolen.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void task_scheduler::execute(task_t &task) {
+  const auto start = clock::now();
+  task();
+  tasks_run.fetch_add(1, std::memory_order_relaxed);
+  if (current_worker != NOT_A_WORKER) {
+    busy_ns.fetch_add((clock::now() - start).count(),
+                      std::memory_order_relaxed);
+  }
+}
+
+void task_scheduler::run(std::size_t index) {
+  current_worker = index;
+  task_t task;
+  for (;;) {
+    if (pop(index, task)) {
+      execute(task);
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock lock(m_mutex);
+    m_wake.wait(lock, [this] { return m_stop || m_queued != 0; });
+    if (m_stop) {
+      return;
+    }
+  }
+}
+
+task_group::~task_group() {
+  try {
+    wait();
+  } catch (const std::exception &e) {
+    spdlog::error("Task failed: {}", e.what());
+  }
+}
+
+void task_group::run(task_scheduler::task_t task) {
+  ++m_pending;
+  m_scheduler.submit([this, task = std::move(task)] {
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard lock(m_mutex);
+      if (!m_error) {
+        m_error = std::current_exception();
+      }
+    }
+    std::lock_guard lock(m_mutex);
+    if (--m_pending == 0) {
+      m_done.notify_all();
+    }
+  });
+}
+
+void task_group::wait() {
+  constexpr std::chrono::milliseconds RECHECK{1};
+  while (m_pending != 0) {
+    if (m_scheduler.run_one()) {
+      continue;
+    }
+    // The remaining tasks are running elsewhere, or queued behind others
+    std::unique_lock lock(m_mutex);
+    m_done.wait_for(lock, RECHECK, [this] { return m_pending == 0; });
+  }
+
+  std::exception_ptr error;
+  {
+    std::lock_guard lock(m_mutex);
+    std::swap(error, m_error);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
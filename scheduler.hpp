@@ -0,0 +1,120 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP 1
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct scheduler_stats_t {
+  std::size_t workers = 0;
+  uint64_t tasks = 0;  // Run by workers and by threads waiting on a group
+  uint64_t steals = 0; // Taken from another worker's deque
+  std::chrono::nanoseconds busy{0};   // Summed over the workers
+  std::chrono::nanoseconds uptime{0}; // Since the workers started
+
+  // Share of the workers' time spent running tasks
+  [[nodiscard]] auto utilization() const -> double {
+    const auto available = uptime.count() * static_cast<int64_t>(workers);
+    return available > 0 ? static_cast<double>(busy.count()) /
+                               static_cast<double>(available)
+                         : 0;
+  }
+};
+
+// Process-wide pool every parallel path runs on, so concurrent exports and
+// builds share the cores instead of each spawning a thread per core. Each
+// worker pops its own deque from the back and steals from the front of the
+// others' when it runs dry.
+class task_scheduler {
+public:
+  using task_t = std::function<void()>;
+
+  // Started on first use with set_workers(), SQLPARSER_WORKERS or one worker
+  // per core, in that order
+  static auto instance() -> task_scheduler &;
+
+  // Only has an effect before the first instance() call
+  static void set_workers(std::size_t workers);
+
+  // Without starting the workers when nothing has used them yet
+  static auto stats() -> scheduler_stats_t;
+
+  task_scheduler(const task_scheduler &) = delete;
+  auto operator=(const task_scheduler &) -> task_scheduler & = delete;
+
+  [[nodiscard]] auto workers() const -> std::size_t {
+    return m_workers.size();
+  }
+
+  // From a worker the task goes to its own deque, otherwise round robin
+  void submit(task_t task);
+
+  // Runs one queued task on the calling thread, false when there was none
+  auto run_one() -> bool;
+
+  // For long running work outside a task_group. It gets a thread of its
+  // own: in a worker's deque, run_one() could pick it up and stall a query
+  // waiting on its own tasks. The future rethrows.
+  template <typename Function> static auto async(Function &&function) {
+    return std::async(std::launch::async, std::forward<Function>(function))
+        .share();
+  }
+
+private:
+  struct worker_t {
+    std::mutex mutex;
+    std::deque<task_t> tasks;
+    std::thread thread;
+  };
+
+  explicit task_scheduler(std::size_t workers);
+  ~task_scheduler();
+
+  void run(std::size_t index);
+  auto pop(std::size_t index, task_t &task) -> bool;
+  void execute(task_t &task);
+
+  std::vector<std::unique_ptr<worker_t>> m_workers;
+  std::atomic<std::size_t> m_next{0};
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::atomic<std::size_t> m_queued{0};
+  bool m_stop = false;
+};
+
+// Tasks that are joined together. wait() runs queued tasks while the
+// group's are pending, so waiting from a worker doesn't starve the pool.
+class task_group {
+public:
+  explicit task_group(task_scheduler &scheduler = task_scheduler::instance())
+      : m_scheduler(scheduler) {}
+  ~task_group();
+
+  task_group(const task_group &) = delete;
+  auto operator=(const task_group &) -> task_group & = delete;
+
+  void run(task_scheduler::task_t task);
+
+  // Rethrows the first exception one of the tasks threw
+  void wait();
+
+private:
+  task_scheduler &m_scheduler;
+  std::atomic<std::size_t> m_pending{0};
+  std::mutex m_mutex;
+  std::condition_variable m_done;
+  std::exception_ptr m_error;
+};
+
+#endif // SCHEDULER_HPP
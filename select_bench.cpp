@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+#include "SqlParser.hpp"
+#include "morsel.hpp"
+#include "scheduler.hpp"
+
+// Times a filtered SELECT without an index the three ways it can run: in the
+// engine's serial scan, in morsels over rows loaded with every column, and
+// in morsels over only the columns the filter and projection read
+namespace {
+
+using clock = std::chrono::steady_clock;
+using DB_ENGINE::Record;
+
+constexpr int RUNS = 5;
+constexpr std::size_t PADDING_COLUMNS = 8;
+
+// id, score, name and padding columns the query never reads
+void generate(SqlParser &parser, std::size_t rows) {
+  std::string create = "create table bench (id int primary key, score double,"
+                       " name char(16)";
+  for (std::size_t i = 0; i < PADDING_COLUMNS; ++i) {
+    create += ", pad" + std::to_string(i) + " char(24)";
+  }
+  parser.parse_query(create + ");");
+
+  auto &engine = parser.get_engine();
+  std::vector<std::string> values;
+  for (std::size_t row = 0; row < rows; ++row) {
+    values.clear();
+    values.push_back(std::to_string(row));
+    values.push_back(std::to_string(row * 7919 % 1000) + ".5");
+    values.push_back("name" + std::to_string(row % 97));
+    for (std::size_t i = 0; i < PADDING_COLUMNS; ++i) {
+      values.push_back("padding value " + std::to_string(row + i));
+    }
+    engine.add("bench", {values.begin(), values.end()});
+  }
+}
+
+auto positions(const std::vector<std::string> &columns,
+               const std::vector<std::string> &of)
+    -> std::vector<std::size_t> {
+  std::vector<std::size_t> out;
+  for (const auto &column : columns) {
+    out.push_back(
+        static_cast<std::size_t>(std::ranges::find(of, column) - of.begin()));
+  }
+  return out;
+}
+
+auto same_rows(const std::vector<Record> &a, const std::vector<Record> &b)
+    -> bool {
+  return std::ranges::equal(a, b, {}, &Record::m_fields, &Record::m_fields);
+}
+
+// Best of RUNS
+template <typename Plan>
+auto measure(Plan plan, std::vector<Record> &rows) -> double {
+  double best = std::numeric_limits<double>::max();
+  for (int run = 0; run < RUNS; ++run) {
+    const auto start = clock::now();
+    rows = plan();
+    const std::chrono::duration<double, std::milli> elapsed =
+        clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+} // namespace
+
+int main(const int argc, const char **argv) {
+  if (argc < 2) {
+    std::cout << "usage: sql_select_bench <rows> [workers]\n";
+    std::cout << "  runs select id, name from bench where score > 900 on a "
+                 "new table in a\n";
+    std::cout << "  scratch directory, timing each way of filtering it\n";
+    return EXIT_FAILURE;
+  }
+  spdlog::set_level(spdlog::level::warn);
+  if (argc > 2) {
+    task_scheduler::set_workers(std::strtoul(argv[2], nullptr, 10));
+  }
+  const auto stamp = clock::now().time_since_epoch().count();
+  const auto scratch = std::filesystem::temp_directory_path() /
+                       ("sql_select_bench-" + std::to_string(stamp));
+  std::filesystem::create_directories(scratch);
+  const auto started_in = std::filesystem::current_path();
+  std::filesystem::current_path(scratch);
+
+  int status = EXIT_SUCCESS;
+  try {
+    SqlParser parser;
+    generate(parser, std::strtoul(argv[1], nullptr, 10));
+    auto &engine = parser.get_engine();
+
+    const auto all = engine.get_table_attributes("bench");
+    const auto projection = engine.sort_attributes("bench", {"id", "name"});
+    const auto narrow =
+        engine.sort_attributes("bench", {"id", "name", "score"});
+    const auto predicate =
+        engine.get_comparator("bench", DB_ENGINE::Comp::G, "score", "900");
+
+    std::vector<Record> scan;
+    std::vector<Record> wide;
+    std::vector<Record> narrowed;
+    const auto scan_ms = measure(
+        [&] { return engine.load("bench", projection, predicate).records; },
+        scan);
+    const auto wide_ms = measure(
+        [&] {
+          return filter_project(engine.load("bench", all).records, predicate,
+                                positions(projection, all));
+        },
+        wide);
+    const auto narrow_ms = measure(
+        [&] {
+          return filter_project(
+              engine.load("bench", narrow).records,
+              widen_predicate(predicate, positions(narrow, all), all.size()),
+              positions(projection, narrow));
+        },
+        narrowed);
+    if (!same_rows(wide, scan) || !same_rows(narrowed, scan)) {
+      spdlog::error("The morsel plans don't return the scan's rows");
+      status = EXIT_FAILURE;
+    }
+
+    std::cout << "workers: " << task_scheduler::instance().workers()
+              << "  columns: " << all.size() << " of which read "
+              << narrow.size() << "  rows matched: " << scan.size() << "\n";
+    std::cout << "serial scan: " << scan_ms << " ms\n";
+    std::cout << "morsels, every column loaded: " << wide_ms << " ms\n";
+    std::cout << "morsels, columns read loaded: " << narrow_ms << " ms\n";
+  } catch (const std::exception &e) {
+    spdlog::error("Benchmark failed: {}", e.what());
+    status = EXIT_FAILURE;
+  }
+  std::filesystem::current_path(started_in);
+  std::filesystem::remove_all(scratch);
+  return status;
+}
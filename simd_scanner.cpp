@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "simd_scanner.hpp"
+#include "statement_end.hpp"
+
+using token = yy::parser::token;
+
+namespace {
+
+#if defined(__AVX2__)
+
+using vec_t = __m256i;
+constexpr std::size_t VEC_SIZE = 32;
+constexpr uint32_t FULL_MASK = 0xFFFFFFFF;
+
+inline auto load(const char *p) -> vec_t {
+  return _mm256_loadu_si256(reinterpret_cast<const vec_t *>(p));
+}
+inline auto splat(char c) -> vec_t { return _mm256_set1_epi8(c); }
+inline auto eq(vec_t a, vec_t b) -> vec_t { return _mm256_cmpeq_epi8(a, b); }
+inline auto gt(vec_t a, vec_t b) -> vec_t { return _mm256_cmpgt_epi8(a, b); }
+inline auto bit_or(vec_t a, vec_t b) -> vec_t { return _mm256_or_si256(a, b); }
+inline auto bit_and(vec_t a, vec_t b) -> vec_t {
+  return _mm256_and_si256(a, b);
+}
+inline auto to_mask(vec_t v) -> uint32_t {
+  return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+}
+
+#elif defined(__SSE2__)
+
+using vec_t = __m128i;
+constexpr std::size_t VEC_SIZE = 16;
+constexpr uint32_t FULL_MASK = 0xFFFF;
+
+inline auto load(const char *p) -> vec_t {
+  return _mm_loadu_si128(reinterpret_cast<const vec_t *>(p));
+}
+inline auto splat(char c) -> vec_t { return _mm_set1_epi8(c); }
+inline auto eq(vec_t a, vec_t b) -> vec_t { return _mm_cmpeq_epi8(a, b); }
+inline auto gt(vec_t a, vec_t b) -> vec_t { return _mm_cmpgt_epi8(a, b); }
+inline auto bit_or(vec_t a, vec_t b) -> vec_t { return _mm_or_si128(a, b); }
+inline auto bit_and(vec_t a, vec_t b) -> vec_t { return _mm_and_si128(a, b); }
+inline auto to_mask(vec_t v) -> uint32_t {
+  return static_cast<uint32_t>(_mm_movemask_epi8(v));
+}
+
+#endif
+
+constexpr auto is_space(char c) -> bool {
+  return c == ' ' || c == '\t' || c == '\n';
+}
+constexpr auto is_letter(char c) -> bool {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+constexpr auto is_digit(char c) -> bool { return c >= '0' && c <= '9'; }
+constexpr auto is_ident(char c) -> bool {
+  return is_letter(c) || is_digit(c) || c == '_';
+}
+constexpr auto is_quote(char c) -> bool { return c == '\''; }
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+// One bit per byte of the register loaded at p
+inline auto space_mask(const char *p) -> uint32_t {
+  const vec_t v = load(p);
+  return to_mask(bit_or(bit_or(eq(v, splat(' ')), eq(v, splat('\t'))),
+                        eq(v, splat('\n'))));
+}
+
+// Bytes >= 0x80 compare as negative, so they fall outside every range
+inline auto ident_mask(const char *p) -> uint32_t {
+  const vec_t v = load(p);
+  const vec_t folded = bit_or(v, splat(0x20));
+  const vec_t letter = bit_and(gt(folded, splat('a' - 1)),
+                               gt(splat('z' + 1), folded));
+  const vec_t digit = bit_and(gt(v, splat('0' - 1)), gt(splat('9' + 1), v));
+  return to_mask(bit_or(bit_or(letter, digit), eq(v, splat('_'))));
+}
+
+inline auto digit_mask(const char *p) -> uint32_t {
+  const vec_t v = load(p);
+  return to_mask(bit_and(gt(v, splat('0' - 1)), gt(splat('9' + 1), v)));
+}
+
+inline auto quote_mask(const char *p) -> uint32_t {
+  return to_mask(eq(load(p), splat('\'')));
+}
+
+// First byte in [p, end) whose class is not in the mask. The padding after
+// end never matches any class, so the loads past it are harmless.
+template <uint32_t (*Mask)(const char *), bool (*)(char)>
+auto skip(const char *p, const char *end) -> const char * {
+  while (p < end) {
+    const uint32_t rest = ~Mask(p) & FULL_MASK;
+    if (rest != 0) {
+      return std::min(p + std::countr_zero(rest), end);
+    }
+    p += VEC_SIZE;
+  }
+  return end;
+}
+
+// First byte in [p, end) whose class is in the mask, or end
+template <uint32_t (*Mask)(const char *), bool (*)(char)>
+auto find(const char *p, const char *end) -> const char * {
+  while (p < end) {
+    const uint32_t hits = Mask(p);
+    if (hits != 0) {
+      return std::min(p + std::countr_zero(hits), end);
+    }
+    p += VEC_SIZE;
+  }
+  return end;
+}
+
+#else
+
+template <auto Mask, bool (*Pred)(char)>
+auto skip(const char *p, const char *end) -> const char * {
+  while (p < end && Pred(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+template <auto Mask, bool (*Pred)(char)>
+auto find(const char *p, const char *end) -> const char * {
+  while (p < end && !Pred(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+constexpr auto space_mask = nullptr;
+constexpr auto ident_mask = nullptr;
+constexpr auto digit_mask = nullptr;
+constexpr auto quote_mask = nullptr;
+
+#endif
+
+struct keyword_t {
+  std::string_view text;
+  int kind;
+};
+
+// Same keywords as lexer.l, they win over {id} only on an exact match
+constexpr std::array<keyword_t, 33> KEYWORDS{{
+    {"insert", token::INSERT}, {"update", token::UPDATE},
+    {"delete", token::DELETE}, {"select", token::SELECT},
+    {"create", token::CREATE}, {"drop", token::DROP},
+    {"from", token::FROM},     {"into", token::INTO},
+    {"set", token::SET},       {"values", token::VALUES},
+    {"where", token::WHERE},   {"and", token::AND},
+    {"or", token::OR},         {"between", token::BETWEEN},
+    {"table", token::TABLE},   {"index", token::INDEX},
+    {"column", token::ID},     {"seq", token::SEQ},
+    {"avl", token::AVL},       {"isam", token::ISAM},
+    {"int", token::INT},       {"double", token::DOUBLE},
+    {"char", token::CHAR},     {"bool", token::BOOL},
+    {"on", token::ON},         {"explain", token::EXPLAIN},
+    {"analyze", token::ANALYZE}, {"show", token::SHOW},
+    {"metrics", token::METRICS}, {"arrow", token::ARROW},
+    {"copy", token::COPY},       {"to", token::TO},
+    {"concurrently", token::CONCURRENTLY},
+}};
+
+constexpr std::string_view PRIMARY_KEY = "primary key";
+
+// Identifiers only hold [a-zA-Z0-9_], none of which folds onto another letter
+auto find_keyword(const char *text, std::size_t length) -> int {
+  for (const auto &keyword : KEYWORDS) {
+    if (keyword.text.size() != length) {
+      continue;
+    }
+    bool match = true;
+    for (std::size_t i = 0; i < length && match; ++i) {
+      match = (text[i] | 0x20) == keyword.text[i];
+    }
+    if (match) {
+      return keyword.kind;
+    }
+  }
+  return -1;
+}
+
+} // namespace
+
+void simd_scanner::advance(std::size_t length) {
+  loc->step();
+  loc->columns(static_cast<int>(length));
+  m_token = m_pos;
+  m_pos += length;
+}
+
+auto simd_scanner::fill() -> bool {
+  m_buffer.erase(0, m_pos);
+  m_end -= m_pos;
+  m_pos = 0;
+  m_token = 0;
+  m_buffer.resize(m_end);
+
+  // Tokens never span a ';' unless inside a string, so read statement sized
+  // chunks and keep reading until one ends outside a string
+  bool read = false;
+  do {
+    if (!std::getline(*m_in, m_chunk, ';')) {
+      break;
+    }
+    read = true;
+    m_buffer += m_chunk;
+    if (!m_in->eof()) {
+      m_buffer += ';';
+    }
+  } while (statement_end(m_buffer) == std::string_view::npos);
+
+  m_end = m_buffer.size();
+  m_buffer.append(PADDING, '\0');
+  return read;
+}
+
+int simd_scanner::next_token(yy::parser::semantic_type *const lval,
+                             yy::parser::location_type * /*location*/) {
+  yylval = lval;
+
+  for (;;) {
+    if (m_pos == m_end && !fill()) {
+      return 0;
+    }
+
+    const char *begin = m_buffer.data() + m_pos;
+    const char *end = m_buffer.data() + m_end;
+    const char c = *begin;
+
+    if (is_space(c)) {
+      advance(skip<space_mask, is_space>(begin, end) - begin);
+      continue;
+    }
+
+    switch (c) {
+    case '*':
+      advance(1);
+      return token::ALL;
+    case ';':
+      advance(1);
+      return token::ENDL;
+    case '(':
+      advance(1);
+      return token::PI;
+    case ')':
+      advance(1);
+      return token::PD;
+    case ',':
+      advance(1);
+      return token::SEP;
+    case '=':
+      advance(1);
+      return token::EQUAL;
+    case '<':
+    case '>': {
+      const bool or_equal = begin + 1 < end && begin[1] == '=';
+      advance(or_equal ? 2 : 1);
+      if (c == '<') {
+        return or_equal ? token::LE : token::L;
+      }
+      return or_equal ? token::GE : token::G;
+    }
+    default:
+      break;
+    }
+
+    if (is_letter(c)) {
+      if (static_cast<std::size_t>(end - begin) >= PRIMARY_KEY.size() &&
+          std::memcmp(begin, PRIMARY_KEY.data(), PRIMARY_KEY.size()) == 0) {
+        advance(PRIMARY_KEY.size());
+        return token::PK;
+      }
+
+      const auto length = static_cast<std::size_t>(
+          skip<ident_mask, is_ident>(begin + 1, end) - begin);
+      const int kind = find_keyword(begin, length);
+      // flex returns ID for "column" without a value, set one anyway
+      if (kind == -1 || kind == token::ID) {
+        yylval->emplace<std::string>(begin, length);
+      }
+      advance(length);
+      return kind == -1 ? static_cast<int>(token::ID) : kind;
+    }
+
+    if (is_digit(c) || c == '.') {
+      const char *last = skip<digit_mask, is_digit>(begin, end);
+      const bool floating = last < end && *last == '.';
+      if (floating) {
+        last = skip<digit_mask, is_digit>(last + 1, end);
+      }
+      const std::string text(begin, last);
+      advance(text.size());
+      if (floating) {
+        yylval->emplace<double>() = std::stod(text);
+        return token::FLOATING;
+      }
+      yylval->emplace<int>() = std::stoi(text);
+      return token::NUM;
+    }
+
+    if (is_quote(c)) {
+      const char *closing = find<quote_mask, is_quote>(begin + 1, end);
+      if (closing != end) {
+        const auto length = static_cast<std::size_t>(closing + 1 - begin);
+        yylval->emplace<std::string>(begin, length);
+        advance(length);
+        return token::STRING;
+      }
+    }
+
+    spdlog::info("Unknown character");
+    advance(1);
+  }
+}
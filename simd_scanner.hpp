@@ -0,0 +1,82 @@
+#ifndef SIMD_SCANNER_HPP
+#define SIMD_SCANNER_HPP 1
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+
+#include "fingerprint.hpp"
+#include "location.hh"
+#include "parser.tab.hh"
+#include "trace.hpp"
+
+// Hand-written replacement for the flex scanner generated from lexer.l.
+// Produces the same token stream, but skips whitespace, finds string
+// delimiters and classifies identifier characters a SIMD register at a time.
+class simd_scanner {
+public:
+  simd_scanner(std::istream *in) : m_in(in) {
+    loc = new yy::parser::location_type();
+  }
+
+  ~simd_scanner() { delete loc; }
+
+  simd_scanner(const simd_scanner &) = delete;
+  auto operator=(const simd_scanner &) -> simd_scanner & = delete;
+
+  int yylex(yy::parser::semantic_type *const lval,
+            yy::parser::location_type *location) {
+    trace_span span("yylex", "lex");
+    const int kind = next_token(lval, location);
+    m_fingerprint.add(kind, text());
+    m_text.add(kind, text());
+    return kind;
+  }
+
+  // Text of the last token returned by yylex
+  [[nodiscard]] auto text() const -> std::string_view {
+    return {m_buffer.data() + m_token, m_pos - m_token};
+  }
+
+  [[nodiscard]] auto fingerprint() const -> uint64_t {
+    return m_fingerprint.last();
+  }
+
+  void capture_text(bool enabled) { m_text.enable(enabled); }
+
+  // Only filled in while capture_text is on
+  [[nodiscard]] auto statement_text() const -> const std::string & {
+    return m_text.last();
+  }
+
+  // What was lexed of a statement that failed, capture_text must be on
+  [[nodiscard]] auto failed_statement_text() const -> const std::string & {
+    return m_text.current();
+  }
+
+private:
+  // Loads are done a full register past the current position, so the
+  // buffer always keeps this many NUL bytes after the input
+  static constexpr std::size_t PADDING = 32;
+
+  int next_token(yy::parser::semantic_type *const lval,
+                 yy::parser::location_type *location);
+  auto fill() -> bool;
+  void advance(std::size_t length);
+
+  std::istream *m_in;
+  std::string m_buffer;
+  std::string m_chunk;
+  std::size_t m_pos = 0;
+  std::size_t m_end = 0;
+  std::size_t m_token = 0; // Start of the last matched text
+
+  query_fingerprint m_fingerprint;
+  text_capture m_text;
+
+  yy::parser::semantic_type *yylval = nullptr;
+  yy::parser::location_type *loc = nullptr;
+};
+
+#endif // SIMD_SCANNER_HPP
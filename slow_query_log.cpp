@@ -0,0 +1,161 @@
+#include <filesystem>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+#include "slow_query_log.hpp"
+
+slow_query_log::slow_query_log(std::string path,
+                               std::chrono::nanoseconds threshold,
+                               std::size_t max_bytes, std::size_t max_files,
+                               std::size_t max_queued)
+    : m_path(std::move(path)), m_threshold(threshold), m_max_bytes(max_bytes),
+      m_max_files(max_files), m_max_queued(max_queued),
+      m_out(m_path, std::ios::app) {
+  if (!m_out.good()) {
+    spdlog::error("Failed to open slow query log: {}", m_path);
+    throw std::runtime_error("Failed to open slow query log");
+  }
+  std::error_code error;
+  m_bytes = std::filesystem::file_size(m_path, error);
+  m_thread = std::thread(&slow_query_log::run, this);
+}
+
+slow_query_log::~slow_query_log() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  m_thread.join();
+}
+
+void slow_query_log::push(slow_query_t entry) {
+  {
+    std::lock_guard lock(m_mutex);
+    // A slow disk mustn't grow memory without bound, the writer reports
+    // what was lost
+    if (m_queue.size() >= m_max_queued) {
+      ++m_dropped;
+      return;
+    }
+    m_queue.push_back(std::move(entry));
+  }
+  m_cv.notify_one();
+}
+
+void slow_query_log::run() {
+  std::vector<slow_query_t> batch;
+  std::unique_lock lock(m_mutex);
+  while (true) {
+    m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+    if (m_queue.empty()) {
+      return;
+    }
+    batch.swap(m_queue);
+    const std::size_t dropped = std::exchange(m_dropped, 0);
+    lock.unlock();
+
+    if (dropped != 0) {
+      spdlog::warn("Slow query log fell behind, dropped {} entries", dropped);
+    }
+    for (const auto &entry : batch) {
+      write(entry);
+    }
+    m_out.flush();
+    batch.clear();
+
+    lock.lock();
+  }
+}
+
+void slow_query_log::write(const slow_query_t &entry) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  using std::chrono::milliseconds;
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+  writer.StartObject();
+  writer.Key("time_ms");
+  writer.Int64(
+      duration_cast<milliseconds>(entry.when.time_since_epoch()).count());
+  // Hex string, JSON numbers lose precision past 2^53
+  writer.Key("fingerprint");
+  writer.String(fmt::format("{:016x}", entry.fingerprint).c_str());
+  writer.Key("query");
+  writer.String(entry.text.c_str(),
+                static_cast<rapidjson::SizeType>(entry.text.size()));
+  writer.Key("total_us");
+  writer.Int64(duration_cast<microseconds>(entry.stats.total).count());
+
+  writer.Key("phases_us");
+  writer.StartObject();
+  for (std::size_t phase = 0; phase < PHASES; ++phase) {
+    writer.Key(PHASE_NAMES[phase].data());
+    writer.Int64(
+        duration_cast<microseconds>(entry.stats.phase_times[phase]).count());
+  }
+  writer.EndObject();
+
+  writer.Key("plan");
+  writer.StartArray();
+  for (const auto &step : entry.stats.plan) {
+    writer.StartObject();
+    writer.Key("table");
+    writer.String(step.table.c_str());
+    writer.Key("access");
+    writer.String(step.access.c_str());
+    writer.Key("index");
+    if (step.index_column.empty()) {
+      writer.Null();
+    } else {
+      writer.String(step.index_column.c_str());
+    }
+    writer.Key("rows");
+    writer.Uint64(step.rows);
+    writer.Key("probes");
+    writer.Uint64(step.probes);
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.Key("rows_examined");
+  writer.Uint64(entry.stats.rows_examined);
+  writer.Key("rows_returned");
+  writer.Uint64(entry.stats.rows_returned);
+  // Most bytes the statement had allocated at once, only counted when built
+  // with SQLPARSER_ALLOC_PROFILE
+  writer.Key("peak_bytes");
+  if (ALLOC_PROFILING) {
+    writer.Uint64(entry.stats.allocs.peak_bytes);
+  } else {
+    writer.Null();
+  }
+  writer.EndObject();
+
+  if (m_bytes + buffer.GetSize() + 1 > m_max_bytes) {
+    rotate();
+  }
+  m_out.write(buffer.GetString(),
+              static_cast<std::streamsize>(buffer.GetSize()));
+  m_out.put('\n');
+  m_bytes += buffer.GetSize() + 1;
+}
+
+void slow_query_log::rotate() {
+  m_out.close();
+  std::error_code error;
+  for (std::size_t i = m_max_files; i > 1; --i) {
+    std::filesystem::rename(m_path + "." + std::to_string(i - 1),
+                            m_path + "." + std::to_string(i), error);
+  }
+  std::filesystem::rename(m_path, m_path + ".1", error);
+  if (error) {
+    spdlog::error("Failed to rotate slow query log: {}", error.message());
+  }
+  m_out.open(m_path, std::ios::trunc);
+  m_bytes = 0;
+}
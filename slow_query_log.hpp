@@ -0,0 +1,65 @@
+#ifndef SLOW_QUERY_LOG_HPP
+#define SLOW_QUERY_LOG_HPP 1
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "query_stats.hpp"
+
+struct slow_query_t {
+  std::chrono::system_clock::time_point when;
+  std::string text;
+  uint64_t fingerprint = 0;
+  statement_stats_t stats;
+};
+
+// JSON Lines log of statements slower than a threshold. Formatting and I/O
+// happen on a background thread, push() only queues the entry, and drops it
+// while max_queued entries are waiting. Once the file grows past max_bytes
+// it is rotated to path.1, path.2, ... up to max_files.
+class slow_query_log {
+public:
+  slow_query_log(std::string path, std::chrono::nanoseconds threshold,
+                 std::size_t max_bytes = 64UL << 20, std::size_t max_files = 4,
+                 std::size_t max_queued = 1024);
+  ~slow_query_log();
+
+  slow_query_log(const slow_query_log &) = delete;
+  auto operator=(const slow_query_log &) -> slow_query_log & = delete;
+
+  [[nodiscard]] auto threshold() const -> std::chrono::nanoseconds {
+    return m_threshold;
+  }
+
+  void push(slow_query_t entry);
+
+private:
+  void run();
+  void write(const slow_query_t &entry);
+  void rotate();
+
+  std::string m_path;
+  std::chrono::nanoseconds m_threshold;
+  std::size_t m_max_bytes;
+  std::size_t m_max_files;
+  std::size_t m_max_queued;
+
+  std::ofstream m_out;
+  std::size_t m_bytes = 0;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<slow_query_t> m_queue;
+  std::size_t m_dropped = 0; // Since the writer last looked
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+#endif // SLOW_QUERY_LOG_HPP
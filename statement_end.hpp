@@ -0,0 +1,25 @@
+#ifndef STATEMENT_END_HPP
+#define STATEMENT_END_HPP 1
+
+#include <cstddef>
+#include <string_view>
+
+// Offset just past the ';' that ends the statement starting at from, or npos
+// if text holds no complete statement there. This is where the scanners see
+// an ENDL: a string literal is '...' with no escapes, so 'it''s' is two
+// literals and quotes simply pair up. The grammar has no comments, a quote
+// after "--" opens a literal for the scanners too.
+inline auto statement_end(std::string_view text, std::size_t from = 0)
+    -> std::size_t {
+  bool quoted = false;
+  for (std::size_t i = from; i < text.size(); ++i) {
+    if (text[i] == '\'') {
+      quoted = !quoted;
+    } else if (text[i] == ';' && !quoted) {
+      return i + 1;
+    }
+  }
+  return std::string_view::npos;
+}
+
+#endif // STATEMENT_END_HPP
@@ -0,0 +1,107 @@
+#include <fstream>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+void tracer::start() {
+  std::lock_guard lock(m_mutex);
+  for (const auto &buffer : m_buffers) {
+    std::lock_guard buffer_lock(buffer->mutex);
+    buffer->events.clear();
+  }
+  m_origin = std::chrono::steady_clock::now();
+  m_enabled.store(true, std::memory_order_relaxed);
+}
+
+auto tracer::local_buffer() -> thread_buffer_t & {
+  // Shared with the tracer so a thread's events survive the thread
+  thread_local std::shared_ptr<thread_buffer_t> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<thread_buffer_t>();
+    std::lock_guard lock(m_mutex);
+    buffer->tid = m_buffers.size() + 1;
+    m_buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void tracer::record(trace_event_t event) {
+  auto &buffer = local_buffer();
+  std::lock_guard lock(buffer.mutex);
+  buffer.events.push_back(std::move(event));
+}
+
+void tracer::write(const std::string &path) {
+  using std::chrono::duration;
+  using micros = duration<double, std::micro>;
+
+  rapidjson::StringBuffer json;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(json);
+  const auto pid = static_cast<int64_t>(getpid());
+
+  writer.StartObject();
+  writer.Key("traceEvents");
+  writer.StartArray();
+  {
+    std::lock_guard lock(m_mutex);
+    for (const auto &buffer : m_buffers) {
+      std::lock_guard buffer_lock(buffer->mutex);
+      const auto tid = static_cast<int64_t>(buffer->tid);
+
+      writer.StartObject();
+      writer.Key("name");
+      writer.String("thread_name");
+      writer.Key("ph");
+      writer.String("M");
+      writer.Key("pid");
+      writer.Int64(pid);
+      writer.Key("tid");
+      writer.Int64(tid);
+      writer.Key("args");
+      writer.StartObject();
+      writer.Key("name");
+      writer.String(fmt::format("thread {}", tid).c_str());
+      writer.EndObject();
+      writer.EndObject();
+
+      for (const auto &event : buffer->events) {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(event.name);
+        writer.Key("cat");
+        writer.String(event.category);
+        writer.Key("ph");
+        writer.String("X");
+        writer.Key("ts");
+        writer.Double(micros(event.start - m_origin).count());
+        writer.Key("dur");
+        writer.Double(micros(event.duration).count());
+        writer.Key("pid");
+        writer.Int64(pid);
+        writer.Key("tid");
+        writer.Int64(tid);
+        if (!event.detail.empty()) {
+          writer.Key("args");
+          writer.StartObject();
+          writer.Key("detail");
+          writer.String(event.detail.c_str(),
+                        static_cast<rapidjson::SizeType>(event.detail.size()));
+          writer.EndObject();
+        }
+        writer.EndObject();
+      }
+    }
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  std::ofstream out(path, std::ios::trunc);
+  out.write(json.GetString(), static_cast<std::streamsize>(json.GetSize()));
+  if (!out.good()) {
+    spdlog::error("Failed to write trace to {}", path);
+    throw std::runtime_error("Failed to write trace");
+  }
+}
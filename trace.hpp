@@ -0,0 +1,99 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP 1
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Complete ("X") event of the Chrome Trace Event format
+struct trace_event_t {
+  const char *name; // Static strings only, events outlive their callers
+  const char *category;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::nanoseconds duration;
+  std::string detail; // Shown as args.detail, e.g. the table name
+};
+
+// Process-wide span recorder. Every thread appends to its own buffer, the
+// buffers are only merged by write(), so recording never contends.
+class tracer {
+public:
+  static auto instance() -> tracer & {
+    static tracer trace;
+    return trace;
+  }
+
+  tracer(const tracer &) = delete;
+  auto operator=(const tracer &) -> tracer & = delete;
+
+  // Checked by every span, cheap enough to leave the hooks in release builds
+  [[nodiscard]] static auto enabled() -> bool {
+    return instance().m_enabled.load(std::memory_order_relaxed);
+  }
+
+  // Drops what was recorded before and starts recording
+  void start();
+  void stop() { m_enabled.store(false, std::memory_order_relaxed); }
+
+  void record(trace_event_t event);
+
+  // {"traceEvents": [...]}, loadable by Perfetto and chrome://tracing
+  void write(const std::string &path);
+
+private:
+  struct thread_buffer_t {
+    std::mutex mutex; // Only contended while write() runs
+    uint64_t tid;
+    std::vector<trace_event_t> events;
+  };
+
+  tracer() = default;
+
+  auto local_buffer() -> thread_buffer_t &;
+
+  std::atomic<bool> m_enabled{false};
+  std::chrono::steady_clock::time_point m_origin;
+  std::mutex m_mutex;
+  std::vector<std::shared_ptr<thread_buffer_t>> m_buffers;
+};
+
+// Records the lifetime of the scope as one event when tracing is enabled
+class trace_span {
+public:
+  explicit trace_span(const char *name, const char *category = "sql",
+                      std::string_view detail = {})
+      : m_enabled(tracer::enabled()) {
+    if (m_enabled) {
+      m_name = name;
+      m_category = category;
+      m_detail = detail;
+      m_start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~trace_span() {
+    if (m_enabled) {
+      tracer::instance().record({m_name, m_category, m_start,
+                                 std::chrono::steady_clock::now() - m_start,
+                                 std::move(m_detail)});
+    }
+  }
+
+  trace_span(const trace_span &) = delete;
+  auto operator=(const trace_span &) -> trace_span & = delete;
+
+private:
+  bool m_enabled;
+  const char *m_name = nullptr;
+  const char *m_category = nullptr;
+  std::string m_detail;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,71 @@
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#include "workload_capture.hpp"
+
+namespace {
+
+template <typename T> void write_raw(std::ofstream &out, const T &value) {
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T> auto read_raw(std::ifstream &in, T &value) -> bool {
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+} // namespace
+
+workload_capture::workload_capture(const std::string &path)
+    : m_out(path, std::ios::binary | std::ios::trunc) {
+  if (!m_out.good()) {
+    spdlog::error("Failed to open workload capture: {}", path);
+    throw std::runtime_error("Failed to open workload capture");
+  }
+  m_out.write(MAGIC.data(), static_cast<std::streamsize>(MAGIC.size()));
+}
+
+void workload_capture::record(std::chrono::system_clock::time_point start,
+                              uint64_t session_id, std::string_view text) {
+  const auto timestamp_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          start.time_since_epoch())
+          .count());
+  const auto length = static_cast<uint32_t>(text.size());
+
+  std::lock_guard lock(m_mutex);
+  write_raw(m_out, timestamp_ns);
+  write_raw(m_out, session_id);
+  write_raw(m_out, length);
+  m_out.write(text.data(), length);
+}
+
+void workload_capture::flush() {
+  std::lock_guard lock(m_mutex);
+  m_out.flush();
+}
+
+auto read_workload(const std::string &path)
+    -> std::vector<captured_statement_t> {
+  std::ifstream in(path, std::ios::binary);
+  std::string magic(workload_capture::MAGIC.size(), '\0');
+  if (!in.read(magic.data(), static_cast<std::streamsize>(magic.size())) ||
+      magic != workload_capture::MAGIC) {
+    spdlog::error("Not a workload capture: {}", path);
+    throw std::runtime_error("Not a workload capture");
+  }
+
+  std::vector<captured_statement_t> statements;
+  captured_statement_t statement;
+  uint32_t length = 0;
+  while (read_raw(in, statement.timestamp_ns) &&
+         read_raw(in, statement.session_id) && read_raw(in, length)) {
+    statement.text.resize(length);
+    if (!in.read(statement.text.data(), length)) {
+      spdlog::error("Truncated workload capture: {}", path);
+      break;
+    }
+    statements.push_back(statement);
+  }
+  return statements;
+}
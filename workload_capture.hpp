@@ -0,0 +1,44 @@
+#ifndef WORKLOAD_CAPTURE_HPP
+#define WORKLOAD_CAPTURE_HPP 1
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct captured_statement_t {
+  uint64_t timestamp_ns = 0; // Wall clock at the start of the statement
+  uint64_t session_id = 0;
+  std::string text;
+};
+
+// Binary log of every statement executed by the sessions attached to it.
+// The file is the 8 byte MAGIC followed by one record per statement:
+// timestamp_ns (u64), session_id (u64), length (u32) and the text, all
+// integers in host byte order.
+class workload_capture {
+public:
+  static constexpr std::string_view MAGIC{"SQLCAP1\0", 8};
+
+  explicit workload_capture(const std::string &path);
+
+  workload_capture(const workload_capture &) = delete;
+  auto operator=(const workload_capture &) -> workload_capture & = delete;
+
+  void record(std::chrono::system_clock::time_point start,
+              uint64_t session_id, std::string_view text);
+
+  void flush();
+
+private:
+  std::mutex m_mutex;
+  std::ofstream m_out;
+};
+
+auto read_workload(const std::string &path)
+    -> std::vector<captured_statement_t>;
+
+#endif // WORKLOAD_CAPTURE_HPP